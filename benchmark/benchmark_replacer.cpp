@@ -0,0 +1,161 @@
+//-----------------------------------------------------------------------------
+// robolina
+//-----------------------------------------------------------------------------
+
+// Compares the speed of find_and_replace() for the case modes and for mixed case modes, with and without compiling
+// the replacer. The whole word rules include short words, which are often found within the identifiers of the text.
+// Then measures the time to add and compile a large number of rules.
+// Usage: benchmark_replacer [text size in MiB]
+
+#include <robolina/robolina.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    std::string random_word(std::mt19937& generator, size_t min_length, size_t max_length)
+    {
+        std::uniform_int_distribution<size_t> length_distribution(min_length, max_length);
+        std::uniform_int_distribution<int> character_distribution('a', 'z');
+        std::string word(length_distribution(generator), ' ');
+        for (char& c : word)
+        {
+            c = static_cast<char>(character_distribution(generator));
+        }
+        return word;
+    }
+
+    // Creates a source code like text of identifiers in different casing, some of them are texts to find.
+    std::string create_text(std::mt19937& generator, size_t size, const std::vector<std::string>& words, const std::vector<std::string>& texts_to_find)
+    {
+        static const char* separators[] = { " ", " ", ", ", "(", ");\n", " = ", ".", "\n    " };
+        std::uniform_int_distribution<size_t> word_distribution(0, words.size() - 1);
+        std::uniform_int_distribution<size_t> separator_distribution(0, sizeof(separators) / sizeof(separators[0]) - 1);
+        std::uniform_int_distribution<size_t> text_to_find_distribution(0, texts_to_find.size() - 1);
+        std::uniform_int_distribution<size_t> insert_distribution(0, 1000);
+        std::string text;
+        text.reserve(size + 64);
+        while (text.size() < size)
+        {
+            std::string identifier;
+            if (insert_distribution(generator) < 8)
+            {
+                identifier = texts_to_find[text_to_find_distribution(generator)];
+            }
+            else
+            {
+                identifier = words[word_distribution(generator)] + "_" + words[word_distribution(generator)];
+            }
+            switch (generator() % 3)
+            {
+            case 0:
+                identifier[0] = static_cast<char>(identifier[0] - 'a' + 'A');
+                break;
+            case 1:
+                for (char& c : identifier)
+                {
+                    c = (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+                }
+                break;
+            default:
+                break;
+            }
+            text += identifier;
+            text += separators[separator_distribution(generator)];
+        }
+        return text;
+    }
+
+    struct counting_sink
+    {
+        size_t size = 0;
+
+        void write(const char* begin, const char* end)
+        {
+            size += static_cast<size_t>(end - begin);
+        }
+    };
+
+    // Returns the speed in MiB/s.
+    double measure(const robolina::case_preserve_replacer<char>& replacer, const std::string& text)
+    {
+        counting_sink sink;
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        replacer.find_and_replace(text.c_str(), text.size(), sink);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return static_cast<double>(text.size()) / (1024.0 * 1024.0) / seconds;
+    }
+
+    double get_milliseconds(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+    {
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const size_t text_size_in_mib = argc > 1 ? static_cast<size_t>(std::strtoul(argv[1], nullptr, 10)) : 16;
+    const size_t rule_counts[] = { 10, 100, 1000 };
+    const robolina::case_mode modes[] = { robolina::case_mode::match_case, robolina::case_mode::ignore_case, robolina::case_mode::preserve_case };
+    const char* mode_names[] = { "match case", "ignore case", "preserve case", "mixed" };
+    const size_t mode_count = sizeof(mode_names) / sizeof(mode_names[0]);
+
+    std::mt19937 generator(42);
+    std::vector<std::string> words;
+    for (size_t i = 0; i < 5000; ++i)
+    {
+        words.push_back(random_word(generator, 1, 8));
+    }
+    std::vector<std::string> texts_to_find;
+    for (size_t i = 0; i < 1000; ++i)
+    {
+        texts_to_find.push_back(random_word(generator, 3, 8) + "_" + random_word(generator, 3, 8));
+    }
+    const std::string text = create_text(generator, text_size_in_mib * 1024 * 1024, words, texts_to_find);
+
+    std::printf("Text: %.1f MiB, speed in MiB/s\n", static_cast<double>(text.size()) / (1024.0 * 1024.0));
+    std::printf("%10s %14s %11s %12s %12s\n", "rules", "mode", "whole word", "search tree", "compiled");
+    for (size_t rule_count : rule_counts)
+    {
+        for (int whole_word = 0; whole_word < 2; ++whole_word)
+        {
+            for (size_t mode = 0; mode < mode_count; ++mode)
+            {
+                robolina::case_preserve_replacer<char> replacer;
+                for (size_t i = 0; i < rule_count; ++i)
+                {
+                    // The last mode mixes the case modes of the rules.
+                    const robolina::case_mode rule_mode = mode < mode_count - 1 ? modes[mode] : modes[i % (mode_count - 1)];
+                    const std::string& text_to_find = whole_word && i % 2 != 0 ? words[i] : texts_to_find[i];
+                    replacer.add_replacement(text_to_find.c_str(), "replacement", rule_mode, whole_word != 0);
+                }
+                const double tree_speed = measure(replacer, text);
+                replacer.compile();
+                const double compiled_speed = measure(replacer, text);
+                std::printf("%10zu %14s %11s %12.1f %12.1f\n", rule_count, mode_names[mode], whole_word ? "yes" : "no", tree_speed, compiled_speed);
+            }
+        }
+    }
+
+    // Adding many rules at once with add_replacements(), the texts to find are distinct.
+    const size_t large_rule_count = 200000;
+    std::vector<robolina::case_preserve_replacer<char>::replacement> rules;
+    rules.reserve(large_rule_count);
+    for (size_t i = 0; i < large_rule_count; ++i)
+    {
+        rules.push_back({ random_word(generator, 3, 8) + "_" + random_word(generator, 3, 8) + "_" + std::to_string(i), "replacement", modes[i % 3], false });
+    }
+    std::printf("\n%10s %12s %12s\n", "rules", "add ms", "compile ms");
+    robolina::case_preserve_replacer<char> replacer;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    replacer.add_replacements(rules);
+    const std::chrono::steady_clock::time_point added = std::chrono::steady_clock::now();
+    replacer.compile();
+    const std::chrono::steady_clock::time_point compiled = std::chrono::steady_clock::now();
+    std::printf("%10zu %12.0f %12.0f\n", large_rule_count, get_milliseconds(start, added), get_milliseconds(added, compiled));
+    return 0;
+}
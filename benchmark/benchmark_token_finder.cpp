@@ -0,0 +1,147 @@
+//-----------------------------------------------------------------------------
+// robolina
+//-----------------------------------------------------------------------------
+
+// Compares the search speed of the token finder engines for a growing number of tokens.
+// Usage: benchmark_token_finder [text size in MiB]
+// Build with optimizations, and e.g. -mavx2 to use the vectorized fingerprint of the teddy_token_finder.
+
+#include <robolina/cpptokenfinder.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const size_t c_invalid_id = static_cast<size_t>(-1);
+
+    typedef cpptokenfinder::token_finder<char, size_t, size_t, c_invalid_id> finder_type;
+    typedef cpptokenfinder::teddy_token_finder<char, size_t, size_t, c_invalid_id> teddy_finder_type;
+
+    std::string random_identifier(std::mt19937& generator, size_t min_length, size_t max_length)
+    {
+        static const char characters[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_0123456789";
+        std::uniform_int_distribution<size_t> length_distribution(min_length, max_length);
+        std::uniform_int_distribution<size_t> first_character_distribution(0, 51);
+        std::uniform_int_distribution<size_t> character_distribution(0, sizeof(characters) - 2);
+        std::string identifier(length_distribution(generator), ' ');
+        identifier[0] = characters[first_character_distribution(generator)];
+        for (size_t i = 1; i < identifier.size(); ++i)
+        {
+            identifier[i] = characters[character_distribution(generator)];
+        }
+        return identifier;
+    }
+
+    // Creates a source code like text, every 2000 characters on average a token of the token pool is inserted.
+    std::string create_text(std::mt19937& generator, size_t size, const std::vector<std::string>& token_pool)
+    {
+        static const char* separators[] = { " ", " ", " ", ", ", "(", ");\n", " = ", ".", "->", "\n    " };
+        std::vector<std::string> words;
+        for (size_t i = 0; i < 5000; ++i)
+        {
+            words.push_back(random_identifier(generator, 1, 12));
+        }
+        std::uniform_int_distribution<size_t> word_distribution(0, words.size() - 1);
+        std::uniform_int_distribution<size_t> separator_distribution(0, sizeof(separators) / sizeof(separators[0]) - 1);
+        std::uniform_int_distribution<size_t> token_distribution(0, token_pool.size() - 1);
+        std::uniform_int_distribution<size_t> insert_distribution(0, 2000);
+        std::string text;
+        text.reserve(size + 64);
+        while (text.size() < size)
+        {
+            if (insert_distribution(generator) < 8)
+            {
+                text += token_pool[token_distribution(generator)];
+            }
+            else
+            {
+                text += words[word_distribution(generator)];
+            }
+            text += separators[separator_distribution(generator)];
+        }
+        return text;
+    }
+
+    template <typename finder_t>
+    size_t count_tokens(const finder_t& finder, const std::string& text)
+    {
+        size_t count = 0;
+        const char* current = text.data();
+        const char* text_end = text.data() + text.size();
+        const char* token_begin = nullptr;
+        const char* token_end = nullptr;
+        size_t token_id = c_invalid_id;
+        while (finder.find_token(current, text_end, token_begin, token_end, token_id))
+        {
+            ++count;
+            current = token_end;
+        }
+        return count;
+    }
+
+    // Returns the search speed in MiB/s.
+    template <typename finder_t>
+    double measure(const finder_t& finder, const std::string& text, size_t& count)
+    {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        count = count_tokens(finder, text);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return static_cast<double>(text.size()) / (1024.0 * 1024.0) / seconds;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const size_t text_size_in_mib = argc > 1 ? static_cast<size_t>(std::strtoul(argv[1], nullptr, 10)) : 16;
+    const size_t token_counts[] = { 1, 10, 100, 1000, 10000, 100000 };
+    const size_t max_token_count = token_counts[sizeof(token_counts) / sizeof(token_counts[0]) - 1];
+
+    std::mt19937 generator(42);
+    std::vector<std::string> token_pool;
+    for (size_t i = 0; i < max_token_count; ++i)
+    {
+        token_pool.push_back(random_identifier(generator, 6, 16));
+    }
+    const std::string text = create_text(generator, text_size_in_mib * 1024 * 1024, token_pool);
+
+    std::printf("Text: %.1f MiB, speed in MiB/s\n", static_cast<double>(text.size()) / (1024.0 * 1024.0));
+    std::printf("%10s %12s %12s %12s %12s\n", "tokens", "tree", "compiled", "teddy", "found");
+    for (size_t token_count : token_counts)
+    {
+        finder_type finder;
+        teddy_finder_type teddy_finder;
+        for (size_t id = 0; id < token_count; ++id)
+        {
+            try
+            {
+                finder.add_token(token_pool[id], id);
+                teddy_finder.add_token(token_pool[id], id);
+            }
+            catch (const std::invalid_argument&)
+            {
+                // Duplicate token, ignored.
+            }
+        }
+        finder_type compiled_finder = finder;
+        compiled_finder.compile();
+        teddy_finder.compile();
+
+        size_t tree_count = 0;
+        size_t compiled_count = 0;
+        size_t teddy_count = 0;
+        const double tree_speed = measure(finder, text, tree_count);
+        const double compiled_speed = measure(compiled_finder, text, compiled_count);
+        const double teddy_speed = measure(teddy_finder, text, teddy_count);
+        if (tree_count != compiled_count || tree_count != teddy_count)
+        {
+            std::printf("Error: the engines found different tokens.\n");
+            return 1;
+        }
+        std::printf("%10zu %12.1f %12.1f %12.1f %12zu\n", token_count, tree_speed, compiled_speed, teddy_speed, tree_count);
+    }
+    return 0;
+}
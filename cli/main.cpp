@@ -42,6 +42,16 @@
 #include <stdexcept>
 #include <algorithm>
 #include <sstream>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
 
 #if defined(_MSC_VER) || defined(_WIN32)  || defined(_WIN64)
 #define ROBOLINA_WINDOWS
@@ -51,6 +61,24 @@ namespace fs = std::filesystem;
 
 #if defined(ROBOLINA_WINDOWS)
 #include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/xattr.h>
+#endif
+#if defined(__APPLE__)
+#include <sys/acl.h>
+#endif
+#endif
+
+#if defined(ROBOLINA_WINDOWS)
 std::wstring convertToWideString(const std::string& str)
 {
     int size_needed = MultiByteToWideChar(CP_UTF8, 0, str.c_str(), static_cast<int>(str.size()), NULL, 0);
@@ -86,30 +114,45 @@ struct ProcessingOptions
     bool dryRun = false;
     bool allowRename = true; // New option to control file renaming
     std::vector<std::string> customExtensions; // New: custom file extensions
+    size_t jobs = 1; // Number of threads processing files
 };
 
 struct CommandLineOptions
 {
     fs::path filenameOrPath;
+    fs::path compileRulesPath; // Set if the replacements are compiled to a rules file instead of processing a path.
+    fs::path rulesPath; // Set if the replacements are loaded from a compiled rules file.
+    std::vector<std::string> replacementsFiles; // Read after parsing, not at all if their compiled rules are cached.
+    bool useCache = true; // Cache the compiled rules of replacements files, see createCachedReplacer().
     ProcessingOptions processingOptions;
-    std::vector<ReplacementOptions> replacements;
+    std::vector<ReplacementOptions> replacements; // The replacement of the command line, after the ones of the files.
 };
 
 void printUsage()
 {
     std::cout << "Robolina - v" << ROBOLINA_CLI_VERSION_STRING << " - Text find and replace tool with case preservation." << std::endl << std::endl
-              << "Usage: robolina [options] <path> <text-to-find> <replacement-text>" << std::endl << std::endl
+              << "Usage: robolina [options] <path> <text-to-find> <replacement-text>" << std::endl
+              << "       robolina [options] --compile-rules <file> <text-to-find> <replacement-text>" << std::endl
+              << "       robolina [options] --rules <file> <path>" << std::endl
+              << "       Use - as <path> to replace the text read from the standard input and" << std::endl
+              << "       write it to the standard output." << std::endl << std::endl
               << "Options:" << std::endl
               << "  --case-mode <mode>        Set case mode (preserve, ignore, match)." << std::endl
               << "                            Default: preserve" << std::endl
               << "  --match-whole-word        Only replace whole words." << std::endl
               << "  --replacements-file, -f   Optionally provide replacement options in a file." << std::endl
+              << "  --compile-rules <file>    Compile the replacements to a rules file instead" << std::endl
+              << "                            of processing a path." << std::endl
+              << "  --rules <file>            Use the replacements of a compiled rules file." << std::endl
+              << "  --no-cache                Do not cache the compiled replacements files." << std::endl
               << "  --recursive, -r           Process directories recursively." << std::endl
               << "  --verbose, -v             Print detailed information during processing." << std::endl
               << "  --dry-run                 Show what would be replaced without making changes." << std::endl
               << "  --no-rename               Do not rename files, only replace content." << std::endl
               << "  --extensions <list>       Semicolon-separated list of file extensions to" << std::endl
               << "                            process (e.g. .cpp;.h;.txt)" << std::endl
+              << "  --jobs, -j <count>        Number of threads processing files, 0 uses all" << std::endl
+              << "                            cores. Default: 1" << std::endl
               << "  --help, -h                Display this help message." << std::endl
               << std::endl
               << "Examples (Attention: use the --dry-run option before making file changes.):" << std::endl
@@ -118,8 +161,14 @@ void printUsage()
               << R"(  robolina src/ --replacements-file more_replacements.txt "old_name" "new_name")" << std::endl
               << R"(  robolina --match-whole-word --recursive . "findMe" "replaceWithThis")" << std::endl
               << R"(  robolina --extensions .cpp;.h;.txt src/ foo bar)" << std::endl
+              << R"(  robolina --compile-rules rules.rbl --replacements-file replacements.txt)" << std::endl
+              << R"(  robolina --rules rules.rbl --recursive src/)" << std::endl
+              << R"(  git show HEAD:src/main.cpp | robolina - old_name new_name > main.cpp)" << std::endl
               << std::endl
               << "Note: The text-to-find and the replacement-text use C-String escaping." << std::endl << std::endl
+              << "Note: The compiled replacements files are cached in $XDG_CACHE_HOME/robolina" << std::endl
+              << "      (Windows: %LOCALAPPDATA%\\robolina) and used again while their content" << std::endl
+              << "      and the robolina version are unchanged." << std::endl << std::endl
               << "Replacements file syntax example:" << std::endl
               << "----------------------------------------------------------------------" << std::endl
               << "#This is a comment." << std::endl
@@ -314,6 +363,7 @@ CommandLineOptions parseCommandLine(int argc, char* argv[])
 
     int currentArg = 1;
     int positionalIndex = 0;
+    std::string firstPositionalArgument;
     bool replacementsFileUsed = false;
     while (currentArg < argc)
     {
@@ -386,16 +436,49 @@ CommandLineOptions parseCommandLine(int argc, char* argv[])
                 throw std::runtime_error("No valid extensions provided in --extensions");
             }
         }
+        else if (arg == "--jobs" || arg == "-j")
+        {
+            if (currentArg + 1 >= argc)
+            {
+                throw std::runtime_error("Missing value for --jobs");
+            }
+            std::string jobsValue = argv[++currentArg];
+            if (jobsValue.empty() || jobsValue.size() > 4 || jobsValue.find_first_not_of("0123456789") != std::string::npos)
+            {
+                throw std::runtime_error("Invalid value for --jobs: " + jobsValue);
+            }
+            options.processingOptions.jobs = static_cast<size_t>(std::stoul(jobsValue));
+            if (options.processingOptions.jobs == 0)
+            {
+                options.processingOptions.jobs = std::max(1u, std::thread::hardware_concurrency());
+            }
+        }
         else if (arg == "--replacements-file" || arg == "-f") {
             if (currentArg + 1 >= argc)
             {
                 throw std::runtime_error("Missing value for --replacements-file");
             }
-            std::string filePath = argv[++currentArg];
-            loadOptionsFromFile(filePath, options.replacements);
+            options.replacementsFiles.push_back(argv[++currentArg]);
             replacementsFileUsed = true;
         }
-        else if (arg[0] == '-')
+        else if (arg == "--no-cache")
+        {
+            options.useCache = false;
+        }
+        else if (arg == "--compile-rules" || arg == "--rules")
+        {
+            if (currentArg + 1 >= argc)
+            {
+                throw std::runtime_error("Missing value for " + arg);
+            }
+#if defined(ROBOLINA_WINDOWS)
+            const fs::path rulesPath = convertToWideString(argv[++currentArg]);
+#else
+            const fs::path rulesPath = argv[++currentArg];
+#endif
+            (arg == "--rules" ? options.rulesPath : options.compileRulesPath) = rulesPath;
+        }
+        else if (arg[0] == '-' && arg != "-")
         {
             throw std::runtime_error("Unknown option: " + arg);
         }
@@ -404,6 +487,7 @@ CommandLineOptions parseCommandLine(int argc, char* argv[])
             // Use positionalIndex to determine which positional argument this is
             if (positionalIndex == 0)
             {
+                firstPositionalArgument = arg;
 #if defined(ROBOLINA_WINDOWS)
                 options.filenameOrPath = convertToWideString(arg);
 #else
@@ -426,7 +510,37 @@ CommandLineOptions parseCommandLine(int argc, char* argv[])
         }
         currentArg++;
     }
-    if (positionalIndex == 1 && replacementsFileUsed)
+    if (!options.compileRulesPath.empty() && !options.rulesPath.empty())
+    {
+        throw std::runtime_error("--compile-rules cannot be combined with --rules");
+    }
+    if (!options.compileRulesPath.empty())
+    {
+        // No path is processed, the positional arguments are the texts.
+        options.filenameOrPath.clear();
+        if (positionalIndex == 2)
+        {
+            cliReplacementOptions.replacementText = cliReplacementOptions.textToFind;
+            cliReplacementOptions.textToFind = firstPositionalArgument;
+            options.replacements.push_back(cliReplacementOptions);
+        }
+        else if (positionalIndex != 0 || !replacementsFileUsed)
+        {
+            throw std::runtime_error(positionalIndex > 2 ? "Too many positional arguments" : "Missing required positional arguments");
+        }
+    }
+    else if (!options.rulesPath.empty())
+    {
+        if (positionalIndex == 0)
+        {
+            throw std::runtime_error("Missing required positional arguments");
+        }
+        if (positionalIndex > 1 || replacementsFileUsed)
+        {
+            throw std::runtime_error("--rules cannot be combined with other replacements");
+        }
+    }
+    else if (positionalIndex == 1 && replacementsFileUsed)
     {
         //using replacements file
     }
@@ -491,6 +605,10 @@ fs::path renameFileWithReplacement(const fs::path& originalPath, const robolina:
     std::string stemName = toString(originalPath.stem());
 
     // Replace in the stem name
+    if (!replacer.contains_match(stemName))
+    {
+        return originalPath;
+    }
     std::string newStemName = replacer.find_and_replace(stemName);
 
     // If the stem name didn't change, return the original path
@@ -506,85 +624,409 @@ fs::path renameFileWithReplacement(const fs::path& originalPath, const robolina:
     return newPath;
 }
 
-void processFile(const fs::path& path, const robolina::case_preserve_replacer<char>& replacer, const ProcessingOptions& options)
+// The content of a file to process. Larger regular files are memory mapped and searched in place, small files and
+// special files are read into a buffer.
+class InputFile
 {
-    if (!fs::is_regular_file(path))
+public:
+    InputFile() = default;
+    InputFile(const InputFile&) = delete;
+    InputFile& operator=(const InputFile&) = delete;
+
+    ~InputFile()
     {
-        return;
+#if !defined(ROBOLINA_WINDOWS)
+        if (mappedData != nullptr)
+        {
+            munmap(mappedData, mappedSize);
+        }
+        if (fileDescriptor >= 0)
+        {
+            ::close(fileDescriptor);
+        }
+#endif
     }
-    if (!shouldProcessFile(path, options.customExtensions))
+
+    // Returns false if the file cannot be opened.
+    bool open(const fs::path& path)
     {
-        if (options.verbose)
+#if defined(ROBOLINA_WINDOWS)
+        file.open(path, std::ios::binary);
+        return static_cast<bool>(file);
+#else
+        fileDescriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        return fileDescriptor >= 0;
+#endif
+    }
+
+    // Returns false if the file content cannot be read. A mapped file is read ahead if it is read sequentially.
+    bool load(bool sequentialAccess = true)
+    {
+#if defined(ROBOLINA_WINDOWS)
+        file.seekg(0, std::ios::end);
+        const auto fileSizeInByte = file.tellg();
+        file.seekg(0, std::ios::beg);
+        buffer.resize(static_cast<size_t>(fileSizeInByte));
+        file.read(buffer.data(), fileSizeInByte);
+        return static_cast<bool>(file);
+#else
+        struct stat fileStatus;
+        if (fstat(fileDescriptor, &fileStatus) != 0)
         {
-            std::cout << "Ignored because of file extension: " << toString(path) << std::endl;
+            return false;
         }
-        return;
+        const bool isRegularFile = S_ISREG(fileStatus.st_mode);
+        if (isRegularFile && static_cast<size_t>(fileStatus.st_size) >= minMappedSize)
+        {
+            void* data = mmap(nullptr, static_cast<size_t>(fileStatus.st_size), PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+            if (data != MAP_FAILED)
+            {
+                mappedData = data;
+                mappedSize = static_cast<size_t>(fileStatus.st_size);
+                if (sequentialAccess)
+                {
+                    madvise(mappedData, mappedSize, MADV_SEQUENTIAL);
+                }
+                return true;
+            }
+            // Fall back to reading the file.
+        }
+
+        // Special files may not know their size, so read until the end of the file.
+        const size_t chunkSize = 64 * 1024;
+        if (isRegularFile)
+        {
+            buffer.reserve(static_cast<size_t>(fileStatus.st_size));
+        }
+        for (;;)
+        {
+            const size_t oldSize = buffer.size();
+            buffer.resize(oldSize + chunkSize);
+            const ssize_t readSize = ::read(fileDescriptor, buffer.data() + oldSize, chunkSize);
+            if (readSize < 0 && errno == EINTR)
+            {
+                buffer.resize(oldSize);
+                continue;
+            }
+            buffer.resize(oldSize + (readSize > 0 ? static_cast<size_t>(readSize) : 0));
+            if (readSize <= 0)
+            {
+                return readSize == 0;
+            }
+        }
+#endif
+    }
+
+    bool isMapped() const
+    {
+        return mappedData != nullptr;
+    }
+
+    const char* begin() const
+    {
+        return mappedData != nullptr ? static_cast<const char*>(mappedData) : buffer.data();
+    }
+
+    const char* end() const
+    {
+        return begin() + (mappedData != nullptr ? mappedSize : buffer.size());
+    }
+
+private:
+    static constexpr size_t minMappedSize = 16 * 1024; // Mapping smaller files costs more than reading them.
+    std::vector<char> buffer;
+    void* mappedData = nullptr;
+    size_t mappedSize = 0;
+#if defined(ROBOLINA_WINDOWS)
+    std::ifstream file;
+#else
+    int fileDescriptor = -1;
+#endif
+};
+
+typedef robolina::case_preserve_replacer<char>::edit Edit;
+
+// The outcome of reading a file and finding the texts to replace. It is created by analyzeFile(), which does not
+// print anything and does not change any file, so files can be analyzed in parallel. commitFile() prints the
+// messages and changes the file.
+struct FileResult
+{
+    bool isRegularFile = false;
+    bool ignoredExtension = false;
+    std::string error; // Set if the file could not be read.
+    std::unique_ptr<InputFile> input; // Kept open if the content changes, the edits refer to it.
+    std::vector<Edit> edits;
+    bool hasChanges = false;
+    fs::path newPath;
+    std::exception_ptr exception; // Set if analyzing the file failed on a worker thread.
+    bool analyzeOnCommit = false; // Set if the file is analyzed by the main thread, see processFiles().
+};
+
+FileResult analyzeFile(const fs::path& path, const robolina::case_preserve_replacer<char>& replacer, const ProcessingOptions& options)
+{
+    FileResult result;
+    if (!fs::is_regular_file(path))
+    {
+        return result;
+    }
+    result.isRegularFile = true;
+    if (!shouldProcessFile(path, options.customExtensions))
+    {
+        result.ignoredExtension = true;
+        return result;
     }
 
     // Read file contents
-    std::ifstream file(path, std::ios::binary);
+    auto file = std::make_unique<InputFile>();
+    if (!file->open(path))
+    {
+        result.error = "Could not open file " + toString(path);
+        return result;
+    }
+    if (!file->load())
+    {
+        result.error = "Failed to read file " + toString(path);
+        return result;
+    }
+
+    // The edits are a piece table of the new content, the unchanged text stays in the input file. A large file is
+    // searched by options.jobs threads.
+    replacer.find_edits_parallel(file->begin(), file->end(), result.edits, options.jobs);
 
-    if (!file)
+    // Check if content was changed, the replacement may be equal to the found text.
+    result.hasChanges = std::any_of(result.edits.begin(), result.edits.end(), [&](const Edit& edit)
     {
-        if (options.dryRun)
+        const auto replacementText = replacer.get_replacement_text(edit.replacement_id);
+        return replacementText.size() != edit.length || !std::equal(replacementText.begin(), replacementText.end(), file->begin() + edit.offset);
+    });
+    if (result.hasChanges)
+    {
+        result.input = std::move(file);
+    }
+    else
+    {
+        result.edits.clear();
+    }
+
+    result.newPath = renameFileWithReplacement(path, replacer);
+    return result;
+}
+
+#if !defined(ROBOLINA_WINDOWS)
+// Writes all pieces, the pieces are changed by partial writes.
+bool writePieces(int fileDescriptor, std::vector<iovec>& pieces)
+{
+    const size_t maxPiecesPerWrite = 1024; // IOV_MAX on Linux and macOS
+    size_t first = 0;
+    while (first < pieces.size())
+    {
+        const int count = static_cast<int>(std::min(pieces.size() - first, maxPiecesPerWrite));
+        const ssize_t writtenSize = ::writev(fileDescriptor, &pieces[first], count);
+        if (writtenSize < 0 && errno == EINTR)
         {
-            std::cerr << "Error: Could not open file " << toString(path) << std::endl;
-            return;
+            continue;
         }
-        else
+        if (writtenSize <= 0)
+        {
+            return false;
+        }
+        size_t remainingSize = static_cast<size_t>(writtenSize);
+        while (first < pieces.size() && remainingSize >= pieces[first].iov_len)
         {
-            throw std::runtime_error("Could not open file " + toString(path));
+            remainingSize -= pieces[first].iov_len;
+            ++first;
+        }
+        if (remainingSize > 0)
+        {
+            pieces[first].iov_base = static_cast<char*>(pieces[first].iov_base) + remainingSize;
+            pieces[first].iov_len -= remainingSize;
         }
     }
+    return true;
+}
 
-    file.seekg(0, std::ios::end);
-    const auto fileSizeInByte = file.tellg();
-    file.seekg(0, std::ios::beg);
+// Returns true unless the file is known to have no extended attributes or access control lists.
+bool mayHaveExtendedAttributes(const fs::path& path)
+{
+#if defined(__linux__)
+    // The access control lists are extended attributes on Linux.
+    const ssize_t size = ::listxattr(path.c_str(), nullptr, 0);
+    return size != 0 && !(size < 0 && errno == ENOTSUP);
+#elif defined(__APPLE__)
+    acl_t acl = acl_get_file(path.c_str(), ACL_TYPE_EXTENDED);
+    if (acl != nullptr)
+    {
+        acl_free(acl);
+        return true;
+    }
+    const ssize_t size = ::listxattr(path.c_str(), nullptr, 0, XATTR_NOFOLLOW);
+    return size != 0 && !(size < 0 && errno == ENOTSUP);
+#else
+    (void)path;
+    return true;
+#endif
+}
 
-    // Create a vector one character larger for the null terminator
-    std::vector<char> content(static_cast<size_t>(fileSizeInByte) + 1, '\0');
-    file.read(content.data(), fileSizeInByte);
-    if (!file)
+// Writes the content to a new file, which then replaces the file. The mapped input stays valid, so the unchanged text
+// is not copied. Returns false without changing the file if the new file would lose the links, the owner, the
+// permissions or other attributes of the file, or if it cannot be created next to the file.
+bool writePiecesToNewFile(const fs::path& path, std::vector<iovec>& pieces)
+{
+    struct stat fileStatus;
+    if (lstat(path.c_str(), &fileStatus) != 0 || !S_ISREG(fileStatus.st_mode) || fileStatus.st_nlink != 1 || mayHaveExtendedAttributes(path))
     {
-        if (options.dryRun)
+        return false;
+    }
+    std::string temporaryPath = path.string() + ".robolina-XXXXXX";
+    const int fileDescriptor = mkstemp(&temporaryPath[0]);
+    if (fileDescriptor < 0)
+    {
+        return false;
+    }
+    // The owner is set first, as changing it may clear the set-user-ID and set-group-ID bits.
+    if (fchown(fileDescriptor, fileStatus.st_uid, fileStatus.st_gid) != 0 || fchmod(fileDescriptor, fileStatus.st_mode & 07777) != 0)
+    {
+        ::close(fileDescriptor);
+        ::unlink(temporaryPath.c_str());
+        return false;
+    }
+    bool success = writePieces(fileDescriptor, pieces);
+    success = (::close(fileDescriptor) == 0) && success;
+    if (!success || ::rename(temporaryPath.c_str(), path.c_str()) != 0)
+    {
+        ::unlink(temporaryPath.c_str());
+        throw std::runtime_error("Could not write to file " + toString(path));
+    }
+    return true;
+}
+#endif
+
+// A sink appending to a vector.
+struct VectorSink
+{
+    std::vector<char>& result;
+
+    explicit VectorSink(std::vector<char>& target) : result(target) {}
+
+    void write(const char* begin, const char* end) const
+    {
+        result.insert(result.end(), begin, end);
+    }
+};
+
+// Writes the input file content with the edits applied. On POSIX systems, the unchanged text is written directly from
+// the input using writev(), so it is not copied:
+// - A file read into memory is overwritten in place.
+// - A memory mapped file would be truncated when it is overwritten, which invalidates the mapped text. It is replaced
+//   by a new file, see writePiecesToNewFile().
+// A mapped file whose links, owner or attributes would be lost by replacing it is overwritten in place. Such a large
+// file is not written without copying, its new content is built in memory first.
+void writeFileContent(const fs::path& path, const InputFile& input, const std::vector<Edit>& edits, const robolina::case_preserve_replacer<char>& replacer)
+{
+#if !defined(ROBOLINA_WINDOWS)
+    std::vector<iovec> pieces;
+    pieces.reserve(edits.size() * 2 + 1);
+    auto addPiece = [&pieces](const char* begin, const char* end)
+    {
+        if (begin != end)
+        {
+            iovec piece;
+            piece.iov_base = const_cast<char*>(begin);
+            piece.iov_len = static_cast<size_t>(end - begin);
+            pieces.push_back(piece);
+        }
+    };
+    // The replacement texts are written in the casing of the found texts, so they are collected first.
+    std::vector<char> replacementTexts;
+    std::vector<size_t> replacementEnds;
+    replacementEnds.reserve(edits.size());
+    VectorSink replacementSink(replacementTexts);
+    for (const Edit& edit : edits)
+    {
+        replacer.write_replacement_text(edit.replacement_id, replacementSink);
+        replacementEnds.push_back(replacementTexts.size());
+    }
+    const char* unchangedBegin = input.begin();
+    size_t replacementBegin = 0;
+    for (size_t i = 0; i < edits.size(); ++i)
+    {
+        addPiece(unchangedBegin, input.begin() + edits[i].offset);
+        addPiece(replacementTexts.data() + replacementBegin, replacementTexts.data() + replacementEnds[i]);
+        replacementBegin = replacementEnds[i];
+        unchangedBegin = input.begin() + edits[i].offset + edits[i].length;
+    }
+    addPiece(unchangedBegin, input.end());
+
+    if (input.isMapped())
+    {
+        if (writePiecesToNewFile(path, pieces))
         {
-            std::cerr << "Error: Failed to read file " << toString(path) << std::endl;
             return;
         }
-        else
+    }
+    else
+    {
+        // The input is a copy of the file content, so the file can be overwritten.
+        const int fileDescriptor = ::open(path.c_str(), O_WRONLY | O_TRUNC | O_CLOEXEC);
+        if (fileDescriptor < 0)
         {
-            throw std::runtime_error("Failed to read file " + toString(path));
+            throw std::runtime_error("Could not write to file " + toString(path));
         }
+        const bool success = writePieces(fileDescriptor, pieces);
+        if (!(::close(fileDescriptor) == 0 && success))
+        {
+            throw std::runtime_error("Could not write to file " + toString(path));
+        }
+        return;
     }
-    file.close();
+#endif
 
-    // Create an output vector to hold the replaced content
     std::vector<char> newContent;
-    newContent.reserve(fileSizeInByte);
+    newContent.reserve(static_cast<size_t>(input.end() - input.begin()));
+    VectorSink sink(newContent);
+    replacer.apply_edits(input.begin(), input.end(), edits, sink);
 
-    // Define a vector sink adapter
-    struct vector_sink
+    std::ofstream outFile(path, std::ios::binary);
+    if (!outFile)
     {
-        std::vector<char>& result;
+        throw std::runtime_error("Could not write to file " + toString(path));
+    }
 
-        explicit  vector_sink(std::vector<char>& target) : result(target) {}
+    outFile.write(newContent.data(), static_cast<std::streamsize>(newContent.size()));
+    outFile.close();
+}
 
-        void write(const char* begin, const char* end) const
+void commitFile(const fs::path& path, const FileResult& result, const robolina::case_preserve_replacer<char>& replacer, const ProcessingOptions& options)
+{
+    if (!result.isRegularFile)
+    {
+        return;
+    }
+    if (result.ignoredExtension)
+    {
+        if (options.verbose)
         {
-            result.insert(result.end(), begin, end);
+            std::cout << "Ignored because of file extension: " << toString(path) << std::endl;
         }
-    };
-
-    // Perform the replacement directly using the main method with a sink
-    vector_sink sink(newContent);
-    replacer.find_and_replace(content.data(), fileSizeInByte, sink);
+        return;
+    }
+    if (!result.error.empty())
+    {
+        if (options.dryRun)
+        {
+            std::cerr << "Error: " << result.error << std::endl;
+            return;
+        }
+        else
+        {
+            throw std::runtime_error(result.error);
+        }
+    }
 
-    // Check if content was changed
-    bool hasChanges = (content.size() - 1 != newContent.size()) ||
-                     !std::equal(content.begin(), content.begin() + fileSizeInByte, newContent.begin());
+    const bool hasChanges = result.hasChanges;
+    const fs::path& newPath = result.newPath;
 
     // Flag to track if we need to perform a file rename
-    fs::path newPath = renameFileWithReplacement(path, replacer);
     bool needsRename = (newPath != path) && options.allowRename;
 
     if (hasChanges || needsRename)
@@ -630,14 +1072,7 @@ void processFile(const fs::path& path, const robolina::case_preserve_replacer<ch
                 }
 
                 // Write the content
-                std::ofstream outFile(path, std::ios::binary);
-                if (!outFile)
-                {
-                    throw std::runtime_error("Could not write to file " + toString(path));
-                }
-
-                outFile.write(newContent.data(), static_cast<std::streamsize>(newContent.size()));
-                outFile.close();
+                writeFileContent(path, *result.input, result.edits, replacer);
                 if (options.verbose)
                 {
                     std::cout << "Updated file content." << std::endl;
@@ -674,33 +1109,536 @@ void processFile(const fs::path& path, const robolina::case_preserve_replacer<ch
     }
 }
 
-void processPath(const fs::path& path, const CommandLineOptions& options)
+void processFile(const fs::path& path, const robolina::case_preserve_replacer<char>& replacer, const ProcessingOptions& options)
 {
-    // Create replacer and add the replacement rules
-    robolina::case_preserve_replacer<char> replacer;
-    for (const auto& replacement : options.replacements )
+    commitFile(path, analyzeFile(path, replacer, options), replacer, options);
+}
+
+// Returns for each file whether it is a symbolic link or the target of a symbolic link in the list. Such a file can be
+// changed using another path of the list.
+std::vector<bool> findLinkedFiles(const std::vector<fs::directory_entry>& files)
+{
+    std::vector<bool> linked(files.size(), false);
+    std::set<fs::path> targets;
+    for (size_t i = 0; i < files.size(); ++i)
     {
-        replacer.add_replacement(
-            convertCStringSyntax(replacement.textToFind).c_str(),
-            convertCStringSyntax(replacement.replacementText).c_str(),
+        if (files[i].is_symlink())
+        {
+            linked[i] = true;
+            std::error_code error;
+            const fs::path target = fs::canonical(files[i].path(), error);
+            if (!error)
+            {
+                targets.insert(target);
+            }
+        }
+    }
+    if (targets.empty())
+    {
+        return linked;
+    }
+    std::set<fs::path> targetNames;
+    for (const auto& target : targets)
+    {
+        targetNames.insert(target.filename());
+    }
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        // Only files with the name of a target need to be resolved.
+        if (!linked[i] && targetNames.count(files[i].path().filename()) != 0)
+        {
+            std::error_code error;
+            const fs::path path = fs::canonical(files[i].path(), error);
+            linked[i] = error || targets.count(path) != 0;
+        }
+    }
+    return linked;
+}
+
+// Processes the files using options.jobs threads. The results are the same as processing the files one after the other.
+void processFiles(const std::vector<fs::directory_entry>& files, const robolina::case_preserve_replacer<char>& replacer, const ProcessingOptions& options)
+{
+    const size_t workerCount = std::min(options.jobs, files.size());
+    if (workerCount <= 1)
+    {
+        for (const auto& file : files)
+        {
+            processFile(file.path(), replacer, options);
+        }
+        return;
+    }
+
+    // The workers take the next file by an atomic index and analyze it. The main thread commits the results in the
+    // order of the files, so all messages and file changes happen in the same order as without threads. The workers
+    // stay within a window of files ahead of the last commit to limit the memory used by file contents.
+    // A file which can be reached by several paths, using symbolic or hard links, may be changed by the commit of
+    // another path. It is analyzed by the main thread when it is committed, as it would be without threads.
+    const size_t windowSize = workerCount * 4;
+    const std::vector<bool> linked = findLinkedFiles(files);
+    ProcessingOptions fileOptions = options; // The threads are used for the files, not for the search within a file.
+    fileOptions.jobs = 1;
+    std::vector<std::unique_ptr<FileResult>> results(files.size());
+    std::atomic<size_t> nextIndex(0);
+    std::mutex mutex;
+    std::condition_variable resultReady;
+    std::condition_variable windowMoved;
+    size_t committedCount = 0;
+    bool stop = false;
+
+    auto worker = [&]()
+    {
+        for (;;)
+        {
+            const size_t index = nextIndex.fetch_add(1);
+            if (index >= files.size())
+            {
+                return;
+            }
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                windowMoved.wait(lock, [&]() { return stop || index < committedCount + windowSize; });
+                if (stop)
+                {
+                    return;
+                }
+            }
+            auto result = std::make_unique<FileResult>();
+            try
+            {
+                std::error_code error;
+                if (linked[index] || fs::hard_link_count(files[index].path(), error) > 1)
+                {
+                    result->analyzeOnCommit = true;
+                }
+                else
+                {
+                    *result = analyzeFile(files[index].path(), replacer, fileOptions);
+                }
+            }
+            catch (...)
+            {
+                result->exception = std::current_exception();
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                results[index] = std::move(result);
+            }
+            resultReady.notify_one();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < workerCount; ++i)
+    {
+        workers.emplace_back(worker);
+    }
+
+    auto stopWorkers = [&]()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        windowMoved.notify_all();
+        for (auto& thread : workers)
+        {
+            thread.join();
+        }
+    };
+
+    try
+    {
+        for (size_t index = 0; index < files.size(); ++index)
+        {
+            std::unique_ptr<FileResult> result;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                resultReady.wait(lock, [&]() { return results[index] != nullptr; });
+                result = std::move(results[index]);
+            }
+            if (result->exception)
+            {
+                std::rethrow_exception(result->exception);
+            }
+            if (result->analyzeOnCommit)
+            {
+                *result = analyzeFile(files[index].path(), replacer, fileOptions);
+            }
+            commitFile(files[index].path(), *result, replacer, options);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                committedCount = index + 1;
+            }
+            windowMoved.notify_all();
+        }
+    }
+    catch (...)
+    {
+        stopWorkers();
+        throw;
+    }
+    stopWorkers();
+}
+
+// Collects the processed text in a large buffer before writing it to the standard output.
+class StandardOutputSink
+{
+public:
+    StandardOutputSink()
+    {
+        buffer.reserve(bufferSize);
+    }
+
+    void write(const char* begin, const char* end)
+    {
+        const size_t size = static_cast<size_t>(end - begin);
+        if (buffer.size() + size > bufferSize)
+        {
+            flush();
+        }
+        if (size >= bufferSize)
+        {
+            writeAll(begin, size);
+        }
+        else
+        {
+            buffer.insert(buffer.end(), begin, end);
+        }
+    }
+
+    void flush()
+    {
+        writeAll(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+
+private:
+    static void writeAll(const char* data, size_t size)
+    {
+#if defined(ROBOLINA_WINDOWS)
+        if (std::fwrite(data, 1, size, stdout) != size || std::fflush(stdout) != 0)
+        {
+            throw std::runtime_error("Could not write to the standard output");
+        }
+#else
+        while (size > 0)
+        {
+            const ssize_t writtenSize = ::write(STDOUT_FILENO, data, size);
+            if (writtenSize < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (writtenSize <= 0)
+            {
+                throw std::runtime_error("Could not write to the standard output");
+            }
+            data += writtenSize;
+            size -= static_cast<size_t>(writtenSize);
+        }
+#endif
+    }
+
+    static constexpr size_t bufferSize = 1024 * 1024;
+    std::vector<char> buffer;
+};
+
+// Replaces the text read from the standard input and writes it to the standard output. Only a part of the text is
+// kept in memory, so it can be used in a pipe for texts of any size.
+void processStandardStreams(const robolina::case_preserve_replacer<char>& replacer)
+{
+#if defined(ROBOLINA_WINDOWS)
+    // Keep the line endings unchanged.
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    const size_t chunkSize = 1024 * 1024;
+    StandardOutputSink sink;
+    robolina::case_preserve_replacer<char>::stream_replacer<StandardOutputSink> stream(replacer, sink, chunkSize);
+    std::vector<char> buffer(chunkSize);
+    for (;;)
+    {
+#if defined(ROBOLINA_WINDOWS)
+        const size_t readSize = std::fread(buffer.data(), 1, buffer.size(), stdin);
+        if (readSize == 0)
+        {
+            if (std::ferror(stdin))
+            {
+                throw std::runtime_error("Could not read from the standard input");
+            }
+            break;
+        }
+#else
+        const ssize_t readSize = ::read(STDIN_FILENO, buffer.data(), buffer.size());
+        if (readSize < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (readSize < 0)
+        {
+            throw std::runtime_error("Could not read from the standard input");
+        }
+        if (readSize == 0)
+        {
+            break;
+        }
+#endif
+        stream.write(buffer.data(), buffer.data() + readSize);
+    }
+    stream.finish();
+    sink.flush();
+}
+
+bool isStandardStreamPath(const fs::path& path)
+{
+    return path == "-";
+}
+
+// Adds the replacement rules of the replacements files and the command line to the replacer and compiles them.
+void createReplacer(const CommandLineOptions& options, robolina::case_preserve_replacer<char>& replacer)
+{
+    std::vector<ReplacementOptions> replacementOptions;
+    for (const std::string& filePath : options.replacementsFiles)
+    {
+        loadOptionsFromFile(filePath, replacementOptions);
+    }
+    replacementOptions.insert(replacementOptions.end(), options.replacements.begin(), options.replacements.end());
+
+    std::vector<robolina::case_preserve_replacer<char>::replacement> replacements;
+    replacements.reserve(replacementOptions.size());
+    for (const auto& replacement : replacementOptions)
+    {
+        replacements.push_back({
+            convertCStringSyntax(replacement.textToFind),
+            convertCStringSyntax(replacement.replacementText),
             replacement.caseMode,
             replacement.matchWholeWord
-        );
+        });
+    }
+    replacer.add_replacements(replacements);
+    replacer.compile();
+}
+
+// Writes the compiled replacement rules to a rules file, returns false if the file cannot be written.
+bool writeRules(const fs::path& path, const robolina::case_preserve_replacer<char>& replacer)
+{
+    std::vector<char> data;
+    replacer.save_compiled(data);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), static_cast<std::streamsize>(data.size()));
+    file.close();
+    return static_cast<bool>(file);
+}
+
+// Writes the compiled replacement rules of the command line to a rules file, see --compile-rules.
+void compileRules(const CommandLineOptions& options)
+{
+    robolina::case_preserve_replacer<char> replacer;
+    createReplacer(options, replacer);
+    if (!writeRules(options.compileRulesPath, replacer))
+    {
+        throw std::runtime_error("Failed to write rules file: " + toString(options.compileRulesPath));
+    }
+}
+
+// Loads a rules file written by compileRules(). The replacer refers to the file content, which is mapped or read
+// into a buffer aligned to 8 bytes, so the file must be kept open while the replacer is used.
+void loadRules(const fs::path& path, InputFile& rulesFile, robolina::case_preserve_replacer<char>& replacer)
+{
+    // The state tables are read at random positions during the search.
+    if (!rulesFile.open(path) || !rulesFile.load(false))
+    {
+        throw std::runtime_error("Failed to read rules file: " + toString(path));
+    }
+    try
+    {
+        replacer.load_compiled(rulesFile.begin(), static_cast<size_t>(rulesFile.end() - rulesFile.begin()));
+    }
+    catch (const std::invalid_argument& e)
+    {
+        throw std::runtime_error("Invalid rules file " + toString(path) + ": " + e.what());
+    }
+}
+
+// 64 bit FNV-1a hash of the data identifying the cached rules.
+class RulesHash
+{
+public:
+    void add(const char* data, size_t size)
+    {
+        // The size is added first, so the boundaries of the added data are part of the hash.
+        addBytes(reinterpret_cast<const unsigned char*>(&size), sizeof(size));
+        addBytes(reinterpret_cast<const unsigned char*>(data), size);
+    }
+
+    void add(const std::string& text)
+    {
+        add(text.data(), text.size());
+    }
+
+    std::uint64_t value() const
+    {
+        return hash;
+    }
+
+private:
+    void addBytes(const unsigned char* bytes, size_t size)
+    {
+        for (const unsigned char* p = bytes; p != bytes + size; ++p)
+        {
+            hash = (hash ^ *p) * 1099511628211ull;
+        }
+    }
+
+    std::uint64_t hash = 14695981039346656037ull;
+};
+
+// Returns the value of an environment variable, an empty path if it is not set.
+fs::path getEnvironmentPath(const char* name)
+{
+#if defined(ROBOLINA_WINDOWS)
+    wchar_t* value = nullptr;
+    size_t size = 0;
+    if (_wdupenv_s(&value, &size, convertToWideString(name).c_str()) != 0 || value == nullptr)
+    {
+        return {};
     }
+    fs::path path(value);
+    free(value);
+    return path;
+#else
+    const char* value = std::getenv(name);
+    return value != nullptr ? fs::path(value) : fs::path();
+#endif
+}
 
-    if (fs::is_regular_file(path))
+// Returns the directory of the cached rules, $XDG_CACHE_HOME/robolina, ~/.cache/robolina if XDG_CACHE_HOME is not
+// set or %LOCALAPPDATA%\robolina on Windows. An empty path is returned if there is no such directory.
+fs::path getCacheDirectory()
+{
+    // Relative paths are ignored like by other applications following the XDG Base Directory Specification.
+    const fs::path cacheHome = getEnvironmentPath("XDG_CACHE_HOME");
+    if (cacheHome.is_absolute())
+    {
+        return cacheHome / "robolina";
+    }
+#if defined(ROBOLINA_WINDOWS)
+    const fs::path localAppData = getEnvironmentPath("LOCALAPPDATA");
+    return localAppData.is_absolute() ? localAppData / "robolina" : fs::path();
+#else
+    const fs::path home = getEnvironmentPath("HOME");
+    return home.is_absolute() ? home / ".cache" / "robolina" : fs::path();
+#endif
+}
+
+// Returns the path of the cached rules of the replacements, named by a hash of the version, the contents of the
+// replacements files and the replacement of the command line. An empty path is returned if a replacements file
+// cannot be read, so the error is reported when reading its replacements.
+fs::path getCachedRulesPath(const CommandLineOptions& options, const fs::path& cacheDirectory)
+{
+    RulesHash hash;
+    hash.add(ROBOLINA_CLI_VERSION_STRING);
+    hash.add(std::to_string(robolina::case_preserve_replacer<char>::c_compiled_format_version));
+    for (const std::string& filePath : options.replacementsFiles)
+    {
+        InputFile file;
+#if defined(ROBOLINA_WINDOWS)
+        const fs::path path = convertToWideString(filePath);
+#else
+        const fs::path path = filePath;
+#endif
+        if (!file.open(path) || !file.load())
+        {
+            return {};
+        }
+        hash.add(file.begin(), static_cast<size_t>(file.end() - file.begin()));
+    }
+    for (const ReplacementOptions& replacement : options.replacements)
+    {
+        hash.add(replacement.textToFind);
+        hash.add(replacement.replacementText);
+        hash.add(std::to_string(static_cast<int>(replacement.caseMode)) + (replacement.matchWholeWord ? "w" : ""));
+    }
+    char fileName[32];
+    std::snprintf(fileName, sizeof(fileName), "%016llx.rbl", static_cast<unsigned long long>(hash.value()));
+    return cacheDirectory / fileName;
+}
+
+// Writes the rules to the cache under a temporary name and renames the file, so other processes never load a partly
+// written file. The cache is not needed, so errors are ignored.
+void writeCachedRules(const fs::path& cachedRulesPath, const robolina::case_preserve_replacer<char>& replacer)
+{
+    std::error_code error;
+    fs::create_directories(cachedRulesPath.parent_path(), error);
+    if (error)
+    {
+        return;
+    }
+#if defined(ROBOLINA_WINDOWS)
+    const unsigned long processId = GetCurrentProcessId();
+#else
+    const unsigned long processId = static_cast<unsigned long>(getpid());
+#endif
+    fs::path temporaryPath = cachedRulesPath;
+    temporaryPath += "." + std::to_string(processId) + ".tmp";
+    if (!writeRules(temporaryPath, replacer))
+    {
+        fs::remove(temporaryPath, error);
+        return;
+    }
+    fs::rename(temporaryPath, cachedRulesPath, error);
+    if (error)
+    {
+        fs::remove(temporaryPath, error);
+    }
+}
+
+// Creates the replacer like createReplacer(). The compiled rules of replacements files are cached, so later runs with
+// the same replacements load them like --rules instead of reading and compiling the replacements files again.
+void createCachedReplacer(const CommandLineOptions& options, InputFile& rulesFile, robolina::case_preserve_replacer<char>& replacer)
+{
+    const fs::path cacheDirectory = options.useCache && !options.replacementsFiles.empty() ? getCacheDirectory() : fs::path();
+    const fs::path cachedRulesPath = cacheDirectory.empty() ? fs::path() : getCachedRulesPath(options, cacheDirectory);
+    std::error_code error;
+    if (!cachedRulesPath.empty() && fs::is_regular_file(cachedRulesPath, error))
+    {
+        try
+        {
+            loadRules(cachedRulesPath, rulesFile, replacer);
+            return;
+        }
+        catch (const std::exception&)
+        {
+            // Replaced by the rules compiled below.
+        }
+    }
+    createReplacer(options, replacer);
+    if (!cachedRulesPath.empty())
+    {
+        writeCachedRules(cachedRulesPath, replacer);
+    }
+}
+
+void processPath(const fs::path& path, const robolina::case_preserve_replacer<char>& replacer, const CommandLineOptions& options)
+{
+    if (isStandardStreamPath(path))
+    {
+        processStandardStreams(replacer);
+    }
+    else if (fs::is_regular_file(path))
     {
         processFile(path, replacer, options.processingOptions);
     }
     else if (fs::is_directory(path))
     {
+        // The files are listed before processing them, so renamed files are not found again.
+        std::vector<fs::directory_entry> files;
         if (options.processingOptions.recursive)
         {
             for (const auto& entry : fs::recursive_directory_iterator(path))
             {
                 if (fs::is_regular_file(entry))
                 {
-                    processFile(entry.path(), replacer, options.processingOptions);
+                    files.push_back(entry);
                 }
             }
         }
@@ -710,10 +1648,11 @@ void processPath(const fs::path& path, const CommandLineOptions& options)
             {
                 if (fs::is_regular_file(entry))
                 {
-                    processFile(entry.path(), replacer, options.processingOptions);
+                    files.push_back(entry);
                 }
             }
         }
+        processFiles(files, replacer, options.processingOptions);
     }
     else
     {
@@ -756,11 +1695,27 @@ int main(int argc, char* argv[])
     try
     {
         CommandLineOptions options = parseCommandLine(argc, argv);
-        if (options.processingOptions.dryRun && options.processingOptions.verbose)
+        if (!options.compileRulesPath.empty())
+        {
+            compileRules(options);
+            return 0;
+        }
+        InputFile rulesFile; // Destroyed after the replacer referring to its content.
+        robolina::case_preserve_replacer<char> replacer;
+        if (!options.rulesPath.empty())
+        {
+            loadRules(options.rulesPath, rulesFile, replacer);
+        }
+        else
+        {
+            createCachedReplacer(options, rulesFile, replacer);
+        }
+        // The standard output receives the replaced text, so no messages are printed.
+        if (options.processingOptions.dryRun && options.processingOptions.verbose && !isStandardStreamPath(options.filenameOrPath))
         {
             std::cout << "Performing dry run." << std::endl;
         }
-        processPath(options.filenameOrPath, options);
+        processPath(options.filenameOrPath, replacer, options);
         return 0;
     }
     catch (const std::exception& e)
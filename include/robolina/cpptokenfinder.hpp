@@ -58,9 +58,337 @@ A simple and fast implementation to efficiently find tokens in strings.
 #pragma once
 #include <vector>
 #include <stdexcept>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#if !defined(CPPTOKENFINDER_NO_SIMD)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CPPTOKENFINDER_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CPPTOKENFINDER_SSE2
+#endif
+#if (defined(CPPTOKENFINDER_AVX2) || defined(CPPTOKENFINDER_SSE2)) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
 
 namespace cpptokenfinder
 {
+#if defined(CPPTOKENFINDER_AVX2) || defined(CPPTOKENFINDER_SSE2)
+    // Returns the index of the lowest set bit, the mask must not be 0.
+    inline unsigned int get_lowest_bit_index(unsigned int mask)
+    {
+#if defined(_MSC_VER)
+        unsigned long index = 0;
+        _BitScanForward(&index, mask);
+        return static_cast<unsigned int>(index);
+#else
+        return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+    }
+#endif
+
+    /**
+        \brief A set of characters that can start a token.
+        Used by token_finder to skip text characters that cannot start a token. Only the characters 0 to 255 are
+        stored, all other characters are considered to be in the set. The text of single byte characters is scanned
+        using AVX2 or SSE2 instructions if available, define CPPTOKENFINDER_NO_SIMD to use the scalar scan only.
+        @tparam char_type The type of the characters of the used strings, e.g. char.
+    */
+    template <typename char_type>
+    class first_character_set
+    {
+    public:
+        first_character_set()
+        {
+            clear();
+        }
+
+        /**
+            \brief Removes all characters.
+        */
+        void clear()
+        {
+            std::fill(flags, flags + 256, static_cast<unsigned char>(0));
+            std::fill(low_nibble_bits, low_nibble_bits + 32, static_cast<unsigned char>(0));
+            characters.clear();
+        }
+
+        /**
+            \brief Adds a character value from 0 to 255.
+        */
+        void insert(size_t value)
+        {
+            if (value < 256 && flags[value] == 0)
+            {
+                flags[value] = 1;
+                characters.push_back(static_cast<unsigned char>(value));
+                // Bit (value / 16) % 8 at index value % 16, the second half of the table is used for the values 128 to 255.
+                low_nibble_bits[(value & 0x0F) + ((value & 0x80) ? 16 : 0)] |= static_cast<unsigned char>(1u << ((value >> 4) & 0x07));
+            }
+        }
+
+        /**
+            \brief Returns the number of character values from 0 to 255 in the set.
+        */
+        size_t size() const
+        {
+            return characters.size();
+        }
+
+        /**
+            \brief Returns true if the character can start a token.
+        */
+        bool contains(char_type character) const
+        {
+            typedef typename std::make_unsigned<char_type>::type unsigned_char_type;
+            const size_t value = static_cast<size_t>(static_cast<unsigned_char_type>(character));
+            return value >= 256 || flags[value] != 0;
+        }
+
+        /**
+            \brief Returns the first character in [text_begin, text_end) that is in the set or \c text_end.
+        */
+        const char_type* find(const char_type* text_begin, const char_type* text_end) const
+        {
+            return find(text_begin, text_end, std::integral_constant<bool, sizeof(char_type) == 1>());
+        }
+
+    private:
+        const char_type* find(const char_type* text_begin, const char_type* text_end, std::false_type /*single_byte*/) const
+        {
+            while (text_begin != text_end && !contains(*text_begin))
+            {
+                ++text_begin;
+            }
+            return text_begin;
+        }
+
+        const char_type* find(const char_type* text_begin, const char_type* text_end, std::true_type /*single_byte*/) const
+        {
+            const unsigned char* p = reinterpret_cast<const unsigned char*>(text_begin);
+            const unsigned char* p_end = reinterpret_cast<const unsigned char*>(text_end);
+#if defined(CPPTOKENFINDER_AVX2)
+            // Looks up the bit of the high nibble in the table of the low nibble, 32 characters at a time.
+            if (p_end - p >= 32)
+            {
+                const __m256i low_table = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(low_nibble_bits)));
+                const __m256i high_table = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(low_nibble_bits + 16)));
+                const __m256i bit_table = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                                           1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+                const __m256i high_bit = _mm256_set1_epi8(-128);
+                const __m256i nibble_mask = _mm256_set1_epi8(0x0F);
+                const __m256i zero = _mm256_setzero_si256();
+                for (; p_end - p >= 32; p += 32)
+                {
+                    const __m256i text = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+                    // The shuffle returns 0 for bytes with the high bit set, so each table only answers for its half.
+                    const __m256i low_bits = _mm256_or_si256(_mm256_shuffle_epi8(low_table, text), _mm256_shuffle_epi8(high_table, _mm256_xor_si256(text, high_bit)));
+                    const __m256i high_bits = _mm256_shuffle_epi8(bit_table, _mm256_and_si256(_mm256_srli_epi16(text, 4), nibble_mask));
+                    const unsigned int mask = ~static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(low_bits, high_bits), zero)));
+                    if (mask != 0)
+                    {
+                        return text_begin + (p - reinterpret_cast<const unsigned char*>(text_begin)) + get_lowest_bit_index(mask);
+                    }
+                }
+            }
+#elif defined(CPPTOKENFINDER_SSE2)
+            // Compares with each character of small sets, 16 characters at a time.
+            if (p_end - p >= 16 && !characters.empty() && characters.size() <= 8)
+            {
+                __m128i searched_characters[8];
+                for (size_t i = 0; i < characters.size(); ++i)
+                {
+                    searched_characters[i] = _mm_set1_epi8(static_cast<char>(characters[i]));
+                }
+                for (; p_end - p >= 16; p += 16)
+                {
+                    const __m128i text = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                    __m128i found = _mm_cmpeq_epi8(text, searched_characters[0]);
+                    for (size_t i = 1; i < characters.size(); ++i)
+                    {
+                        found = _mm_or_si128(found, _mm_cmpeq_epi8(text, searched_characters[i]));
+                    }
+                    const unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(found));
+                    if (mask != 0)
+                    {
+                        return text_begin + (p - reinterpret_cast<const unsigned char*>(text_begin)) + get_lowest_bit_index(mask);
+                    }
+                }
+            }
+#endif
+            while (p != p_end && flags[*p] == 0)
+            {
+                ++p;
+            }
+            return text_begin + (p - reinterpret_cast<const unsigned char*>(text_begin));
+        }
+
+        unsigned char flags[256]; // 1 if the character value is in the set.
+        unsigned char low_nibble_bits[32]; // Bit of the high nibble of each value in the set by low nibble, see insert().
+        std::vector<unsigned char> characters; // The values in the set.
+    };
+
+    /**
+        \brief A vector of trivially copyable values that owns them or refers to values owned by the caller, e.g. in a
+        memory-mapped file.
+        Used for the tables of a compiled token finder that can be loaded without copying them, see
+        token_finder::load_compiled(). Referred values are copied when they are changed using owned().
+        @tparam value_type The type of the values.
+    */
+    template <typename value_type>
+    class mappable_vector
+    {
+    public:
+        typedef const value_type* const_iterator;
+
+        /**
+            \brief Refers to values owned by the caller, which must not change or be freed while they are used.
+        */
+        void map(const value_type* p_values, size_t count)
+        {
+            values = std::vector<value_type>();
+            p_mapped_values = p_values;
+            mapped_size = count;
+            mapped = true;
+        }
+
+        /**
+            \brief Returns the owned values to change them, referred values are copied first.
+        */
+        std::vector<value_type>& owned()
+        {
+            if (mapped)
+            {
+                values.assign(p_mapped_values, p_mapped_values + mapped_size);
+                p_mapped_values = nullptr;
+                mapped_size = 0;
+                mapped = false;
+            }
+            return values;
+        }
+
+        /**
+            \brief Removes all values.
+        */
+        void clear()
+        {
+            values.clear();
+            p_mapped_values = nullptr;
+            mapped_size = 0;
+            mapped = false;
+        }
+
+        /**
+            \brief Returns true if the values are owned by the caller, see map().
+        */
+        bool is_mapped() const
+        {
+            return mapped;
+        }
+
+        const value_type* data() const
+        {
+            return mapped ? p_mapped_values : values.data();
+        }
+
+        size_t size() const
+        {
+            return mapped ? mapped_size : values.size();
+        }
+
+        bool empty() const
+        {
+            return size() == 0;
+        }
+
+        const_iterator begin() const
+        {
+            return data();
+        }
+
+        const_iterator end() const
+        {
+            return data() + size();
+        }
+
+        const value_type& operator[](size_t index) const
+        {
+            return data()[index];
+        }
+
+        /**
+            \brief Returns the value at an index, throws an std::out_of_range exception if there is no such value.
+        */
+        const value_type& at(size_t index) const
+        {
+            if (index >= size())
+            {
+                throw std::out_of_range("The index is out of range.");
+            }
+            return data()[index];
+        }
+
+        /**
+            \brief Returns the memory allocated for owned values in bytes, referred values do not count.
+        */
+        size_t capacity_in_bytes() const
+        {
+            return values.capacity() * sizeof(value_type);
+        }
+
+    private:
+        std::vector<value_type> values;
+        const value_type* p_mapped_values = nullptr;
+        size_t mapped_size = 0;
+        bool mapped = false;
+    };
+
+    /**
+        \brief Appends the bytes of trivially copyable values to binary data, followed by zero bytes up to a multiple of
+        8 bytes. Values up to 8 bytes aligned stay aligned if the data is read from an address aligned to 8 bytes.
+    */
+    template <typename value_type>
+    void append_binary_block(std::vector<char>& data, const value_type* p_values, size_t count)
+    {
+        const size_t size = count * sizeof(value_type);
+        const size_t offset = data.size();
+        data.resize(offset + ((size + 7) & ~static_cast<size_t>(7)), 0);
+        if (size != 0)
+        {
+            std::memcpy(&data[offset], p_values, size);
+        }
+    }
+
+    /**
+        \brief Returns the values of a block written by append_binary_block() without copying them and moves the data
+        position past the block.
+        \pre The data position is aligned to 8 bytes.
+        Throws an std::invalid_argument exception if the data ends before the block.
+    */
+    template <typename value_type>
+    const value_type* read_binary_block(const char*& data, const char* data_end, size_t count)
+    {
+        const size_t available_size = static_cast<size_t>(data_end - data);
+        if (count > available_size / sizeof(value_type))
+        {
+            throw std::invalid_argument("Failed to read binary data. The data is truncated.");
+        }
+        const size_t size = std::min(available_size, (count * sizeof(value_type) + 7) & ~static_cast<size_t>(7));
+        const value_type* p_values = reinterpret_cast<const value_type*>(data);
+        data += size;
+        return p_values;
+    }
+
     /**
         \brief Compares two character values for equality.
         The comparer classes are used to be able to apply different modes of comparison
@@ -92,6 +420,17 @@ namespace cpptokenfinder
                 return result;
             }
         \endcode
+
+        A comparer can also provide a fold() method returning a representative character, e.g. the lowercase character.
+        The token finder then stores the folded token characters and folds each searched character once instead of
+        calling the comparer for each compared token character. Tokens only differing in folded characters are the
+        same token. The comparer must return true if and only if the folded characters are equal.
+        \code
+            char fold(char character) const
+            {
+                return lowercase_table[static_cast<unsigned char>(character)];
+            }
+        \endcode
     */
     class token_finder_default_comparer
     {
@@ -107,6 +446,31 @@ namespace cpptokenfinder
         {
             return character_of_token == character_of_searched_text;
         }
+
+        /**
+            \brief Returns the character the comparer compares, i.e. the character itself.
+        */
+        template <typename char_type>
+        char_type fold(char_type character) const
+        {
+            return character;
+        }
+    };
+
+    /**
+        \brief Provides \c type, std::true_type if the comparer has a fold() method for the character type, see
+        token_finder_default_comparer.
+    */
+    template <typename comparer_type, typename char_type>
+    class has_fold
+    {
+        template <typename tested_comparer_type>
+        static auto test(int) -> decltype(std::declval<const tested_comparer_type&>().fold(std::declval<char_type>()), std::true_type());
+        template <typename tested_comparer_type>
+        static std::false_type test(...);
+
+    public:
+        typedef decltype(test<comparer_type>(0)) type;
     };
 
     /**
@@ -127,7 +491,27 @@ namespace cpptokenfinder
     {
     protected:
         class search_tree_entry;
-        typedef std::vector<search_tree_entry> search_tree_entry_list_type;
+
+        // The list of the next entries of a search tree entry. Most entries of a large search tree are leaves or
+        // have a single next entry, so the list stores its size in less memory than a std::vector. The entries
+        // are owned by the search_tree, copying a list does not copy them.
+        class search_tree_entry_list
+        {
+        public:
+            search_tree_entry* begin() { return entries; }
+            search_tree_entry* end() { return entries + entry_count; }
+            const search_tree_entry* begin() const { return entries; }
+            const search_tree_entry* end() const { return entries + entry_count; }
+            bool empty() const { return entry_count == 0; }
+            size_t size() const { return entry_count; }
+            size_t capacity() const { return entry_capacity; }
+            search_tree_entry& back() { return entries[entry_count - 1]; }
+
+            search_tree_entry* entries = nullptr;
+            std::uint32_t entry_count = 0;
+            std::uint32_t entry_capacity = 0;
+        };
+        typedef search_tree_entry_list search_tree_entry_list_type;
 
         // Used for building a search tree used for searching for tokens in texts.
         // example tokens auto, do, double and dolphin will produce a strict hierarchical tree:
@@ -141,130 +525,423 @@ namespace cpptokenfinder
         public:
             search_tree_entry() = default;
             search_tree_entry(char_type c, const token_id_type& id)
-                : character(c)
-                , token_id(id)
+                : token_id(id)
+                , character(c)
             {
             }
-            char_type character;
+            search_tree_entry_list_type next_entries; // First, so the smaller members share the padding.
             token_id_type token_id;
-            search_tree_entry_list_type next_entries;
+            char_type character;
         };
 
-        // Used for searching texts and adding tokens when the input is a string object.
-        // It is used to handle null-terminated strings and string objects alike.
-        template <typename string_iterator_type>
-        class string_wrapper
+        // The search tree owning the root entries and all next entries. The entry lists are allocated from large
+        // blocks of memory instead of one allocation per list. A list growing past its capacity moves its entries to
+        // a list of twice the capacity and leaves the old one for reuse by another list of the same capacity.
+        class search_tree
         {
         public:
-            string_wrapper(string_iterator_type begin_string, string_iterator_type end_string)
-                : pos(begin_string)
-                , end(end_string)
+            search_tree() = default;
+            search_tree(const search_tree& other)
             {
+                root = copy_entries(other.root);
             }
-
-            bool is_end_position() const
+            search_tree(search_tree&& other)
+                : root(other.root)
+                , blocks(std::move(other.blocks))
+                , block_position(other.block_position)
+                , block_size(other.block_size)
+                , allocated_size(other.allocated_size)
             {
-                return pos == end;
+                std::copy(other.unused_lists, other.unused_lists + c_capacity_count, unused_lists);
+                other.reset();
             }
-
-            bool is_last_character()
+            search_tree& operator=(search_tree other)
             {
-                bool result = (pos + 1) == end;
-                return result;
+                std::swap(root, other.root);
+                std::swap(blocks, other.blocks);
+                std::swap(block_position, other.block_position);
+                std::swap(block_size, other.block_size);
+                std::swap(allocated_size, other.allocated_size);
+                std::swap_ranges(unused_lists, unused_lists + c_capacity_count, other.unused_lists);
+                return *this;
             }
 
-            string_wrapper<string_iterator_type>& operator++ ()
+            void clear()
             {
-                ++pos;
-                return *this;
+                blocks.clear();
+                reset();
             }
 
-            const char_type& operator*() const
+            void add_entry(search_tree_entry_list_type& entries, char_type c, const token_id_type& id)
             {
-                return *pos;
+                if (entries.entry_count == entries.entry_capacity)
+                {
+                    const std::uint32_t capacity = entries.entry_capacity == 0 ? 1 : 2 * entries.entry_capacity;
+                    search_tree_entry* const new_entries = allocate(capacity);
+                    std::copy(entries.begin(), entries.end(), new_entries);
+                    release(entries);
+                    entries.entries = new_entries;
+                    entries.entry_capacity = capacity;
+                }
+                entries.entries[entries.entry_count] = search_tree_entry(c, id);
+                ++entries.entry_count;
             }
 
-            const string_iterator_type& get_position() const
+            // Returns the memory allocated for the entries in bytes.
+            size_t size_in_bytes() const
             {
-                return pos;
+                return allocated_size * sizeof(search_tree_entry);
             }
 
-            string_iterator_type pos;
-            string_iterator_type end;
-        };
+            search_tree_entry_list_type root;
 
-        // Used for searching texts and adding tokens when the input is a null-terminated string.
-        // It is used to handle null-terminated strings and string objects alike without searching
-        // for the end of the null-terminated string first.
-        template <typename char_iterator_type>
-        class null_terminated_string_wrapper
-        {
-        public:
-            null_terminated_string_wrapper(char_iterator_type* p_text)
-                : p(p_text)
-            {
-            }
+        private:
+            static const size_t c_capacity_count = 33; // The capacities are the powers of two up to 2^32.
+            static const size_t c_min_block_size = 64;
+            static const size_t c_max_block_size = 16384;
 
-            bool is_end_position() const
+            static size_t get_capacity_index(std::uint32_t capacity)
             {
-                return *p == 0;
+                size_t index = 0;
+                while ((static_cast<std::uint32_t>(1) << index) < capacity)
+                {
+                    ++index;
+                }
+                return index;
             }
 
-            bool is_last_character()
+            search_tree_entry* allocate(std::uint32_t capacity)
             {
-                bool result = *(p + 1) == 0;
-                return result;
+                // An unused list of the capacity stores the next unused one in its first entry.
+                search_tree_entry*& unused = unused_lists[get_capacity_index(capacity)];
+                if (unused != nullptr)
+                {
+                    search_tree_entry* const entries = unused;
+                    unused = entries->next_entries.entries;
+                    return entries;
+                }
+                if (block_size - block_position < capacity)
+                {
+                    // The blocks grow with the tree, so small trees stay small and large ones need few blocks.
+                    block_size = std::max(static_cast<size_t>(capacity), std::min(std::max(allocated_size, static_cast<size_t>(c_min_block_size)), static_cast<size_t>(c_max_block_size)));
+                    blocks.emplace_back(new search_tree_entry[block_size]);
+                    block_position = 0;
+                    allocated_size += block_size;
+                }
+                search_tree_entry* const entries = blocks.back().get() + block_position;
+                block_position += capacity;
+                return entries;
             }
 
-            null_terminated_string_wrapper& operator++ ()
+            void release(const search_tree_entry_list_type& entries)
             {
-                ++p;
-                return *this;
+                if (entries.entry_capacity != 0)
+                {
+                    search_tree_entry*& unused = unused_lists[get_capacity_index(entries.entry_capacity)];
+                    entries.entries->next_entries.entries = unused;
+                    unused = entries.entries;
+                }
             }
 
-            char_iterator_type& operator*() const
+            search_tree_entry_list_type copy_entries(const search_tree_entry_list_type& entries)
             {
-                return *p;
+                search_tree_entry_list_type result;
+                if (entries.entry_capacity != 0)
+                {
+                    result.entries = allocate(entries.entry_capacity);
+                    result.entry_count = entries.entry_count;
+                    result.entry_capacity = entries.entry_capacity;
+                    for (std::uint32_t i = 0; i < entries.entry_count; ++i)
+                    {
+                        result.entries[i] = search_tree_entry(entries.entries[i].character, entries.entries[i].token_id);
+                        result.entries[i].next_entries = copy_entries(entries.entries[i].next_entries);
+                    }
+                }
+                return result;
             }
 
-            char_iterator_type* get_position() const
+            void reset()
             {
-                return p;
+                root = search_tree_entry_list_type();
+                block_position = 0;
+                block_size = 0;
+                allocated_size = 0;
+                std::fill(unused_lists, unused_lists + c_capacity_count, nullptr);
             }
 
-            char_iterator_type* p;
+            std::vector<std::unique_ptr<search_tree_entry[]>> blocks;
+            size_t block_position = 0; // The used entries of the last block.
+            size_t block_size = 0; // The size of the last block.
+            size_t allocated_size = 0; // The entries of all blocks.
+            search_tree_entry* unused_lists[c_capacity_count] = {}; // The first unused list of each capacity.
         };
-    public:
-        /**
-            \brief Adds a token to be found.
-            \param[in] p_token_string The token text.
-            \param[in] token_id The token id.
-            \pre
-             - The \c token_id must not be equal c_invalid_token_id.
-             - The token text must not be NULL.
-             - The token text must not be an empty string.
-             - The token text must not be added more than once.
-            \post
-             - The token is added to the internal data structure and can be found on the next call to find_token().
 
-             Throws an std::invalid_argument exception if the preconditions are not met.
-        */
-        void add_token(const char_type* p_token_string, token_id_type token_id)
+        static const std::uint32_t c_no_state = 0xFFFFFFFF;
+
+        // Doubly linked list of the unused states used by compile() to place the states in the double-array.
+        // States at or above the size of the list are unused, state 0 is the root and always used.
+        class unused_state_list
         {
-            if (p_token_string == nullptr)
+        public:
+            void resize(size_t size)
             {
-                throw std::invalid_argument("Failed to add token. The token string is null.");
+                const size_t previous_size = next_states.size();
+                next_states.resize(size, c_no_state);
+                previous_states.resize(size, c_no_state);
+                for (size_t state = std::max<size_t>(previous_size, 1); state < size; ++state)
+                {
+                    append(static_cast<std::uint32_t>(state));
+                }
             }
-            if (*p_token_string == 0)
+
+            bool is_unused(size_t state) const
             {
-                throw std::invalid_argument("Failed to add token. The token string is empty.");
+                return state >= next_states.size() || (state != 0 && (state == first_state || previous_states[state] != c_no_state));
             }
 
-            add_token_implementation(null_terminated_string_wrapper<const char_type>(p_token_string), token_id);
-        }
-
-        /**
-            \brief Adds a token to be found.
+            void remove(std::uint32_t state)
+            {
+                if (state >= next_states.size() || !is_unused(state))
+                {
+                    return;
+                }
+                if (state == first_state)
+                {
+                    first_state = next_states[state];
+                }
+                else
+                {
+                    next_states[previous_states[state]] = next_states[state];
+                }
+                if (state == last_state)
+                {
+                    last_state = previous_states[state];
+                }
+                else
+                {
+                    previous_states[next_states[state]] = previous_states[state];
+                }
+                next_states[state] = c_no_state;
+                previous_states[state] = c_no_state;
+            }
+
+            std::uint32_t first() const
+            {
+                return first_state;
+            }
+
+            std::uint32_t next(std::uint32_t state) const
+            {
+                return next_states[state];
+            }
+
+        private:
+            void append(std::uint32_t state)
+            {
+                previous_states[state] = last_state;
+                if (last_state == c_no_state)
+                {
+                    first_state = state;
+                }
+                else
+                {
+                    next_states[last_state] = state;
+                }
+                last_state = state;
+            }
+
+            std::vector<std::uint32_t> next_states;
+            std::vector<std::uint32_t> previous_states;
+            std::uint32_t first_state = c_no_state;
+            std::uint32_t last_state = c_no_state;
+        };
+
+        // A state of the compiled search, see compile(). Each search tree entry becomes a state, the root is state 0.
+        // The states are stored in a double-array: the state following the state s for a character of class c
+        // is t = s.base + c, if t.check == s. Otherwise the character does not continue s.
+        // Aho-Corasick links are added to the states, e.g. for the tokens auto, do, double and dolphin the failure
+        // state of a->u->t->o is d->o, which is also its output state because it is a valid token.
+        struct compiled_state
+        {
+            std::uint32_t base = 0;
+            std::uint32_t check = c_no_state; // Previous state, c_no_state for the root and unused states.
+            std::uint32_t failure = 0; // State of the longest proper suffix that is also in the search tree.
+            std::uint32_t output = 0; // Next state on the failure chain that is a valid token, 0 if there is none.
+            std::uint32_t depth = 0; // Number of characters from the root to this state.
+            token_id_type token_id = c_invalid_token_id;
+        };
+
+        // Used for searching texts and adding tokens when the input is a string object.
+        // It is used to handle null-terminated strings and string objects alike.
+        template <typename string_iterator_type>
+        class string_wrapper
+        {
+        public:
+            string_wrapper(string_iterator_type begin_string, string_iterator_type end_string)
+                : pos(begin_string)
+                , end(end_string)
+            {
+            }
+
+            bool is_end_position() const
+            {
+                return pos == end;
+            }
+
+            bool is_last_character()
+            {
+                bool result = (pos + 1) == end;
+                return result;
+            }
+
+            string_wrapper<string_iterator_type>& operator++ ()
+            {
+                ++pos;
+                return *this;
+            }
+
+            const char_type& operator*() const
+            {
+                return *pos;
+            }
+
+            const string_iterator_type& get_position() const
+            {
+                return pos;
+            }
+
+            string_iterator_type pos;
+            string_iterator_type end;
+        };
+
+        // Used for searching texts and adding tokens when the input is a null-terminated string.
+        // It is used to handle null-terminated strings and string objects alike without searching
+        // for the end of the null-terminated string first.
+        template <typename char_iterator_type>
+        class null_terminated_string_wrapper
+        {
+        public:
+            null_terminated_string_wrapper(char_iterator_type* p_text)
+                : p(p_text)
+            {
+            }
+
+            bool is_end_position() const
+            {
+                return *p == 0;
+            }
+
+            bool is_last_character()
+            {
+                bool result = *(p + 1) == 0;
+                return result;
+            }
+
+            null_terminated_string_wrapper& operator++ ()
+            {
+                ++p;
+                return *this;
+            }
+
+            char_iterator_type& operator*() const
+            {
+                return *p;
+            }
+
+            char_iterator_type* get_position() const
+            {
+                return p;
+            }
+
+            char_iterator_type* p;
+        };
+
+        // Keeps the last, i.e. the longest, token found at a text position.
+        template <typename iterator_type>
+        class longest_token_handler
+        {
+        public:
+            longest_token_handler(iterator_type& token_end, token_id_type& token_id)
+                : token_end_out(token_end)
+                , token_id_out(token_id)
+            {
+            }
+
+            void operator()(const token_id_type& token_id, const iterator_type& token_end)
+            {
+                found = true;
+                token_end_out = token_end;
+                token_id_out = token_id;
+            }
+
+            bool found = false;
+            iterator_type& token_end_out;
+            token_id_type& token_id_out;
+        };
+
+        // Keeps the token with the highest rank found at a text position, the longest one if several have this rank.
+        template <typename iterator_type, typename filter_type>
+        class ranked_token_handler
+        {
+        public:
+            ranked_token_handler(const filter_type& token_filter, const iterator_type& begin)
+                : filter(token_filter)
+                , token_begin(begin)
+                , token_end(begin)
+                , token_id(c_invalid_token_id)
+            {
+            }
+
+            void operator()(const token_id_type& id, const iterator_type& end)
+            {
+                const size_t token_rank = filter(id, token_begin, end);
+                if (token_rank != 0 && token_rank >= rank)
+                {
+                    rank = token_rank;
+                    token_end = end;
+                    token_id = id;
+                }
+            }
+
+            const filter_type& filter;
+            iterator_type token_begin;
+            iterator_type token_end;
+            token_id_type token_id;
+            size_t rank = 0; // 0 if no token has been accepted.
+        };
+    public:
+        /**
+            \brief Adds a token to be found.
+            \param[in] p_token_string The token text.
+            \param[in] token_id The token id.
+            \pre
+             - The \c token_id must not be equal c_invalid_token_id.
+             - The token text must not be NULL.
+             - The token text must not be an empty string.
+             - The token text must not be added more than once.
+            \post
+             - The token is added to the internal data structure and can be found on the next call to find_token().
+             - The token finder is no longer compiled, see compile().
+
+             Throws an std::invalid_argument exception if the preconditions are not met and an std::logic_error
+             exception if the compiled search has been loaded, see load_compiled().
+        */
+        void add_token(const char_type* p_token_string, token_id_type token_id)
+        {
+            if (p_token_string == nullptr)
+            {
+                throw std::invalid_argument("Failed to add token. The token string is null.");
+            }
+            if (*p_token_string == 0)
+            {
+                throw std::invalid_argument("Failed to add token. The token string is empty.");
+            }
+
+            add_token_implementation(null_terminated_string_wrapper<const char_type>(p_token_string), token_id);
+        }
+
+        /**
+            \brief Adds a token to be found.
             \tparam string_type A string object e.g. std::string.
             \param[in] token_string The token text.
             \param[in] token_id The token id.
@@ -274,8 +951,10 @@ namespace cpptokenfinder
              - The token text must not be added more than once.
             \post
              - The token is added to the internal data structure and can be found on the next call to find_token().
+             - The token finder is no longer compiled, see compile().
 
-             Throws an std::invalid_argument exception if the preconditions are not met.
+             Throws an std::invalid_argument exception if the preconditions are not met and an std::logic_error
+             exception if the compiled search has been loaded, see load_compiled().
         */
         template <typename string_type>
         void add_token(const string_type& token_string, token_id_type token_id)
@@ -288,6 +967,95 @@ namespace cpptokenfinder
             add_token_implementation(string_wrapper<typename string_type::const_iterator>(token_string.begin(), token_string.end()), token_id);
         }
 
+        /**
+            \brief Adds several tokens to be found.
+            \tparam string_type A string object e.g. std::string.
+            \param[in] tokens The token texts and their token ids.
+            \pre
+             - The token ids must not be equal c_invalid_token_id.
+             - The token texts must not be empty strings.
+             - Each token text must not be added more than once.
+            \post
+             - The tokens are added to the internal data structure and can be found on the next call to find_token().
+             - The token finder is no longer compiled, see compile().
+
+             If the token finder is empty, the tokens are sorted and the search tree is built in a single pass
+             appending each new search tree entry without searching the entry lists. Otherwise the tokens are added
+             like by add_token().
+
+             Throws an std::invalid_argument exception if the preconditions are not met and an std::logic_error
+             exception if the compiled search has been loaded, see load_compiled().
+        */
+        template <typename string_type>
+        void add_tokens(std::vector<std::pair<string_type, token_id_type>> tokens)
+        {
+            throw_if_loaded();
+            for (const auto& token : tokens)
+            {
+                if (token.first.empty())
+                {
+                    throw std::invalid_argument("Failed to add token. The token string is empty.");
+                }
+                if (token.second == c_invalid_token_id)
+                {
+                    throw std::invalid_argument("Failed to add token. Its token id is invalid.");
+                }
+            }
+            if (!tree.root.empty())
+            {
+                for (const auto& token : tokens)
+                {
+                    add_token_implementation(string_wrapper<typename string_type::const_iterator>(token.first.begin(), token.first.end()), token.second);
+                }
+                return;
+            }
+
+            for (auto& token : tokens)
+            {
+                for (auto& character : token.first)
+                {
+                    character = get_token_character(character);
+                }
+            }
+            std::sort(tokens.begin(), tokens.end(), [](const std::pair<string_type, token_id_type>& lhs, const std::pair<string_type, token_id_type>& rhs) { return lhs.first < rhs.first; });
+            if (std::adjacent_find(tokens.begin(), tokens.end(), [](const std::pair<string_type, token_id_type>& lhs, const std::pair<string_type, token_id_type>& rhs) { return lhs.first == rhs.first; }) != tokens.end())
+            {
+                throw std::invalid_argument("Failed to add token. It has already been added.");
+            }
+
+            // The entry lists from the root to the last character of the previous token. A token shares the
+            // entries of its common prefix with the previous token, its next character is greater than the ones
+            // of the list, so the remaining characters are new entries appended to the lists.
+            std::vector<search_tree_entry_list_type*> path(1, &tree.root);
+            for (size_t i = 0; i < tokens.size(); ++i)
+            {
+                const string_type& token_string = tokens[i].first;
+                size_t common_length = 0;
+                if (i > 0)
+                {
+                    const string_type& previous_token_string = tokens[i - 1].first;
+                    const size_t length = std::min(token_string.size(), previous_token_string.size());
+                    while (common_length < length && token_string[common_length] == previous_token_string[common_length])
+                    {
+                        ++common_length;
+                    }
+                }
+                path.resize(common_length + 1);
+                for (size_t position = common_length; position < token_string.size(); ++position)
+                {
+                    search_tree_entry_list_type& entries = *path[position];
+                    if (&entries == &tree.root)
+                    {
+                        add_first_character(token_string[position]);
+                    }
+                    const bool is_last_character = position + 1 == token_string.size();
+                    tree.add_entry(entries, token_string[position], is_last_character ? tokens[i].second : c_invalid_token_id);
+                    path.push_back(&entries.back().next_entries);
+                }
+            }
+            compiled = false;
+        }
+
         /**
             \brief Finds the next token in a text and returns its position and ID.
             \param[in] text The text to be searched for tokens.
@@ -356,33 +1124,432 @@ namespace cpptokenfinder
         }
 
         /**
-            \brief Clears all tokens added using add_token().
+            \brief Finds the next token accepted by a filter in a text and returns its position and ID.
+            The filter is used to choose between tokens by information not stored in the token finder, e.g. to match the
+            exact characters for some tokens while the comparer ignores the character case.
+            \code
+                size_t operator()(token_id_type token_id, const char_type* token_begin, const char_type* token_end) const;
+            \endcode
+            \param[in] text The text to be searched for tokens.
+            \param[in] filter Called for the tokens found at a text position, returns 0 to reject the token, otherwise
+                              the rank of the token.
+            \param[out] token_begin_out Contains the token start position in \c p_text if a token has been found
+                                        otherwise it is unchanged.
+            \param[out] token_end_out Contains the token end position in \c p_text (one character past the last token character) if a token has been found
+                                      otherwise it is unchanged.
+            \param[out] token_id_out Contains the token ID if a token has been found otherwise it is unchanged.
+            \return Returns true if a token has been accepted.
+            \post
+             - The token at the first text position with an accepted token is returned. If several tokens starting at
+               this position are accepted, the one with the highest rank is returned, the longest one if several have
+               the highest rank.
         */
-        void clear()
+        template <typename filter_type>
+        bool find_ranked_token(const char_type* text, const filter_type& filter, const char_type*& token_begin_out, const char_type*& token_end_out, token_id_type& token_id_out) const
+        {
+            bool result = false;
+            if (text)
+            {
+                result = find_ranked_token_implementation(null_terminated_string_wrapper<const char_type>(text), filter, token_begin_out, token_end_out, token_id_out);
+            }
+            return result;
+        }
+
+        /**
+            \brief Finds the next token accepted by a filter in a text and returns its position and ID.
+            \param[in] text_begin The start of the text to be searched for tokens.
+            \param[in] text_end The end position of the text to be searched for tokens.
+            \param[in] filter Called for the tokens found at a text position, returns 0 to reject the token, otherwise
+                              the rank of the token, see find_ranked_token(const char_type*,const filter_type&,const char_type*&,const char_type*&,token_id_type&)const.
+            \param[out] token_begin_out Contains the token start position in \c p_text if a token has been found
+                                        otherwise it is unchanged.
+            \param[out] token_end_out Contains the token end position in \c p_text (one character past the last token character) if a token has been found
+                                      otherwise it is unchanged.
+            \param[out] token_id_out Contains the token ID if a token has been found otherwise it is unchanged.
+            \return Returns true if a token has been accepted.
+        */
+        template <typename iterator_type, typename filter_type>
+        bool find_ranked_token(iterator_type text_begin, iterator_type text_end, const filter_type& filter, iterator_type& token_begin_out, iterator_type& token_end_out, token_id_type& token_id_out) const
         {
-            root.clear();
+            return find_ranked_token_implementation(string_wrapper<iterator_type>(text_begin, text_end), filter, token_begin_out, token_end_out, token_id_out);
         }
 
-    protected:
-        template <typename text_wrapper_type>
-        void add_token_implementation(text_wrapper_type token_string, token_id_type token_id)
+        /**
+            \brief Finds the token accepted by a filter starting at a text position and returns its end and ID.
+            \param[in] text The text position where the token must start.
+            \param[in] filter Called for the tokens starting at the text position, returns 0 to reject the token, otherwise
+                              the rank of the token, see find_ranked_token(const char_type*,const filter_type&,const char_type*&,const char_type*&,token_id_type&)const.
+            \param[out] token_end_out Contains the token end position in \c p_text (one character past the last token character) if a token has been found
+                                      otherwise it is unchanged.
+            \param[out] token_id_out Contains the token ID if a token has been found otherwise it is unchanged.
+            \return Returns true if a token has been accepted.
+        */
+        template <typename filter_type>
+        bool find_ranked_token_at(const char_type* text, const filter_type& filter, const char_type*& token_end_out, token_id_type& token_id_out) const
         {
-            if (token_id == c_invalid_token_id)
+            bool result = false;
+            if (text)
             {
-                throw std::invalid_argument("Failed to add token. Its token id is invalid.");
+                result = find_ranked_token_at_implementation(null_terminated_string_wrapper<const char_type>(text), filter, token_end_out, token_id_out);
             }
+            return result;
+        }
 
-            // We start with our root list of entries it contains the possible first characters of all tokens.
-            search_tree_entry_list_type* p_current_search_tree_entry_list = &root;
-            // Go through the string of the token and add it to the search tree
-            for (text_wrapper_type character_of_token = token_string; !character_of_token.is_end_position(); ++character_of_token)
-            {
-                search_tree_entry_list_type* p_next_search_tree_entry_list = nullptr;
+        /**
+            \brief Finds the token accepted by a filter starting at a text position and returns its end and ID.
+            \param[in] text_begin The text position where the token must start.
+            \param[in] text_end The end position of the text.
+            \param[in] filter Called for the tokens starting at the text position, returns 0 to reject the token, otherwise
+                              the rank of the token, see find_ranked_token(const char_type*,const filter_type&,const char_type*&,const char_type*&,token_id_type&)const.
+            \param[out] token_end_out Contains the token end position in \c p_text (one character past the last token character) if a token has been found
+                                      otherwise it is unchanged.
+            \param[out] token_id_out Contains the token ID if a token has been found otherwise it is unchanged.
+            \return Returns true if a token has been accepted.
+        */
+        template <typename iterator_type, typename filter_type>
+        bool find_ranked_token_at(iterator_type text_begin, iterator_type text_end, const filter_type& filter, iterator_type& token_end_out, token_id_type& token_id_out) const
+        {
+            return find_ranked_token_at_implementation(string_wrapper<iterator_type>(text_begin, text_end), filter, token_end_out, token_id_out);
+        }
+
+        /**
+            \brief Clears all tokens added using add_token().
+        */
+        void clear()
+        {
+            tree.clear();
+            first_characters.clear();
+            compiled_states.clear();
+            character_classes.clear();
+            class_characters.clear();
+            sorted_classes.clear();
+            compiled = false;
+        }
+
+        /**
+            \brief Compiles the added tokens for a single pass search.
+            Turns the search tree into a contiguous double-array of states with Aho-Corasick failure and output links.
+            A compiled token finder scans each text character only once instead of restarting the search tree walk
+            at every text position. The found tokens are the same as without compiling, i.e. the leftmost token is
+            found and the longest one if several tokens start at the same position.
+            \pre
+             - The comparer must be an equivalence relation, e.g. token_finder_default_comparer or a comparer
+               ignoring the character case. Comparers matching wildcards are not supported.
+            \post
+             - is_compiled() returns true until add_token() or clear() is called.
+
+             Throws an std::length_error exception if the search tree has too many entries.
+        */
+        void compile()
+        {
+            if (compiled_states.is_mapped())
+            {
+                return; // Loaded by load_compiled(), there is no search tree.
+            }
+            compiled = false;
+            compiled_states.clear();
+            character_classes.assign(256, 0);
+            class_characters.clear();
+            sorted_classes.clear();
+
+            std::vector<std::uint32_t> small_token_character_classes(256, 0);
+            std::map<char_type, std::uint32_t> large_token_character_classes;
+            std::vector<std::pair<std::uint32_t, const search_tree_entry*>> next_entries;
+            std::vector<std::pair<const search_tree_entry_list_type*, std::uint32_t>> entries_to_compile;
+            unused_state_list unused_states;
+
+            // Breadth first traversal of the search tree, every entry gets a state placed after the states of its
+            // previous entries.
+            std::vector<compiled_state>& states = compiled_states.owned();
+            states.resize(1);
+            entries_to_compile.emplace_back(&tree.root, 0);
+            for (size_t i = 0; i < entries_to_compile.size(); ++i)
+            {
+                const std::uint32_t state = entries_to_compile[i].second;
+                next_entries.clear();
+                for (const search_tree_entry& entry : *entries_to_compile[i].first)
+                {
+                    next_entries.emplace_back(get_token_character_class(entry.character, small_token_character_classes, large_token_character_classes), &entry);
+                }
+                if (next_entries.empty())
+                {
+                    continue;
+                }
+                // Entries with characters of the same class cannot be told apart by the comparer, the search only
+                // ever continues with the first one.
+                std::stable_sort(next_entries.begin(), next_entries.end(), [](const std::pair<std::uint32_t, const search_tree_entry*>& lhs, const std::pair<std::uint32_t, const search_tree_entry*>& rhs) { return lhs.first < rhs.first; });
+                next_entries.erase(std::unique(next_entries.begin(), next_entries.end(), [](const std::pair<std::uint32_t, const search_tree_entry*>& lhs, const std::pair<std::uint32_t, const search_tree_entry*>& rhs) { return lhs.first == rhs.first; }), next_entries.end());
+
+                // Find a base value placing all next states in unused states. Only a limited number of unused
+                // states is tried before appending the states, so compiling large search trees stays fast.
+                size_t base = std::max(states.size(), static_cast<size_t>(next_entries.front().first)) - next_entries.front().first;
+                size_t remaining_attempts = 256;
+                for (std::uint32_t candidate_state = unused_states.first(); candidate_state != c_no_state && remaining_attempts > 0; candidate_state = unused_states.next(candidate_state), --remaining_attempts)
+                {
+                    if (candidate_state < next_entries.front().first)
+                    {
+                        continue;
+                    }
+                    const size_t candidate_base = candidate_state - next_entries.front().first;
+                    bool all_unused = true;
+                    for (const std::pair<std::uint32_t, const search_tree_entry*>& next_entry : next_entries)
+                    {
+                        if (!unused_states.is_unused(candidate_base + next_entry.first))
+                        {
+                            all_unused = false;
+                            break;
+                        }
+                    }
+                    if (all_unused)
+                    {
+                        base = candidate_base;
+                        break;
+                    }
+                }
+                const size_t required_size = base + next_entries.back().first + 1;
+                if (required_size >= c_no_state)
+                {
+                    throw std::length_error("Failed to compile tokens. The search tree has too many entries.");
+                }
+                if (required_size > states.size())
+                {
+                    states.resize(required_size);
+                    unused_states.resize(required_size);
+                }
+
+                states[state].base = static_cast<std::uint32_t>(base);
+                for (const std::pair<std::uint32_t, const search_tree_entry*>& next_entry : next_entries)
+                {
+                    const std::uint32_t next_state = static_cast<std::uint32_t>(base + next_entry.first);
+                    unused_states.remove(next_state);
+                    compiled_state& compiled_next_state = states[next_state];
+                    compiled_next_state.check = state;
+                    compiled_next_state.depth = states[state].depth + 1;
+                    compiled_next_state.token_id = next_entry.second->token_id;
+                    entries_to_compile.emplace_back(&next_entry.second->next_entries, next_state);
+                }
+            }
+            states.shrink_to_fit();
+
+            // Add the failure and output links, again breadth first, so the links of the shorter prefixes are known
+            // when they are needed.
+            for (size_t i = 1; i < entries_to_compile.size(); ++i)
+            {
+                compiled_state& current_state = states[entries_to_compile[i].second];
+                const compiled_state& previous_state = states[current_state.check];
+                if (current_state.check != 0)
+                {
+                    current_state.failure = get_next_compiled_state(previous_state.failure, entries_to_compile[i].second - previous_state.base);
+                }
+                const compiled_state& failure_state = states[current_state.failure];
+                current_state.output = (failure_state.token_id == c_invalid_token_id) ? failure_state.output : current_state.failure;
+            }
+
+            // Classify the characters 0 to 255 once, the remaining characters are classified during the search.
+            create_sorted_classes(folds_characters());
+            for (size_t character = 0; character < 256; ++character)
+            {
+                character_classes[character] = get_class_by_comparer(static_cast<char_type>(character));
+            }
+            compiled = true;
+        }
+
+        /**
+            \brief Returns the memory used by the compiled search in bytes, 0 if not compiled.
+        */
+        size_t compiled_size_in_bytes() const
+        {
+            return compiled_states.capacity_in_bytes()
+                + character_classes.capacity() * sizeof(std::uint32_t)
+                + class_characters.capacity() * sizeof(char_type)
+                + sorted_classes.capacity() * sizeof(std::pair<char_type, std::uint32_t>);
+        }
+
+        /**
+            \brief Returns the memory used by the search tree in bytes.
+        */
+        size_t search_tree_size_in_bytes() const
+        {
+            return tree.size_in_bytes();
+        }
+
+        /**
+            \brief Returns true if compile() has been called after the last change of the tokens.
+        */
+        bool is_compiled() const
+        {
+            return compiled;
+        }
+
+        /**
+            \brief Returns true if the compiled search has been loaded by load_compiled().
+        */
+        bool is_loaded() const
+        {
+            return compiled_states.is_mapped();
+        }
+
+        /**
+            \brief Appends the compiled search to binary data, see load_compiled().
+            \param[in,out] data The binary data the block of the compiled search is appended to. Its size is a
+                               multiple of 8 bytes, the state table is stored in the native byte order.
+            \pre
+             - is_compiled() returns true.
+
+             Throws an std::logic_error exception if the preconditions are not met.
+        */
+        void save_compiled(std::vector<char>& data) const
+        {
+            if (!compiled)
+            {
+                throw std::logic_error("Failed to save the compiled tokens. The tokens are not compiled.");
+            }
+            const std::uint64_t header[4] = { sizeof(char_type), sizeof(compiled_state), compiled_states.size(), class_characters.size() };
+            append_binary_block(data, header, 4);
+            append_binary_block(data, compiled_states.data(), compiled_states.size());
+            append_binary_block(data, class_characters.data(), class_characters.size());
+        }
+
+        /**
+            \brief Uses a compiled search saved by save_compiled() without copying its state table.
+            Only the small tables of the characters are created, so the search can start right away, e.g. using a
+            memory-mapped file. A teddy_token_finder searches a loaded compiled search without fingerprint.
+            \param[in] data The begin of the block written by save_compiled(), aligned to 8 bytes.
+            \param[in] data_end The end of the data containing the block.
+            \return Returns the end of the block.
+            \pre
+             - The token finder uses the same comparer as the saved one.
+             - The data must not change or be freed until the token finder is cleared or destroyed.
+            \post
+             - The token finder finds the tokens of the saved one, the added tokens are removed.
+             - is_compiled() and is_loaded() return true until clear() is called. Tokens cannot be added and
+               compile() does nothing.
+
+             Throws an std::invalid_argument exception if the block is invalid, the token finder is empty then.
+        */
+        const char* load_compiled(const char* data, const char* data_end)
+        {
+            return load_compiled(data, data_end, [](const token_id_type&, size_t) { return true; });
+        }
+
+        /**
+            \brief Uses a compiled search saved by save_compiled() if all its token IDs are accepted by a validator.
+            \param[in] data The begin of the block written by save_compiled(), aligned to 8 bytes.
+            \param[in] data_end The end of the data containing the block.
+            \param[in] is_valid_token Called with the ID and the length of each token, returns false if the token is not
+                                      valid, e.g. if its ID is out of the range of an index.
+            \return Returns the end of the block.
+
+            See load_compiled(const char*,const char*).
+        */
+        template <typename validator_type>
+        const char* load_compiled(const char* data, const char* data_end, const validator_type& is_valid_token)
+        {
+            clear();
+            try
+            {
+                if (reinterpret_cast<std::uintptr_t>(data) % 8 != 0)
+                {
+                    throw std::invalid_argument("Failed to load the compiled tokens. The data is not aligned to 8 bytes.");
+                }
+                const std::uint64_t* header = read_binary_block<std::uint64_t>(data, data_end, 4);
+                if (header[0] != sizeof(char_type) || header[1] != sizeof(compiled_state))
+                {
+                    throw std::invalid_argument("Failed to load the compiled tokens. The character type or the state size does not match.");
+                }
+                if (header[2] == 0 || header[2] >= c_no_state || header[3] >= header[2])
+                {
+                    throw std::invalid_argument("Failed to load the compiled tokens. The number of states or classes is invalid.");
+                }
+                const size_t state_count = static_cast<size_t>(header[2]);
+                const size_t class_count = static_cast<size_t>(header[3]);
+                const compiled_state* p_states = read_binary_block<compiled_state>(data, data_end, state_count);
+                const char_type* p_class_characters = read_binary_block<char_type>(data, data_end, class_count);
+                validate_compiled_states(p_states, state_count, is_valid_token);
+
+                compiled_states.map(p_states, state_count);
+                class_characters.assign(p_class_characters, p_class_characters + class_count);
+                create_sorted_classes(folds_characters());
+                character_classes.assign(256, 0);
+                for (size_t character = 0; character < 256; ++character)
+                {
+                    character_classes[character] = get_class_by_comparer(static_cast<char_type>(character));
+                }
+                // The first characters are the ones of the classes continuing the root.
+                for (size_t character_class = 1; character_class <= class_count; ++character_class)
+                {
+                    const size_t state = static_cast<size_t>(p_states[0].base) + character_class;
+                    if (state < state_count && p_states[state].check == 0)
+                    {
+                        add_first_character(class_characters[character_class - 1]);
+                    }
+                }
+                compiled = true;
+            }
+            catch (...)
+            {
+                clear();
+                throw;
+            }
+            return data;
+        }
+
+    protected:
+        // Checks the links of the loaded states, so the search cannot read outside of the state table. The depth
+        // of a state is the depth of its previous state plus one, failure and output states are less deep.
+        template <typename validator_type>
+        static void validate_compiled_states(const compiled_state* p_states, size_t state_count, const validator_type& is_valid_token)
+        {
+            if (p_states[0].check != c_no_state || p_states[0].depth != 0 || p_states[0].failure != 0 || p_states[0].output != 0)
+            {
+                throw std::invalid_argument("Failed to load the compiled tokens. The root state is invalid.");
+            }
+            for (size_t state = 1; state < state_count; ++state)
+            {
+                const compiled_state& current_state = p_states[state];
+                if (current_state.check == c_no_state)
+                {
+                    continue; // Unused, cannot be reached.
+                }
+                if (current_state.check >= state_count || current_state.failure >= state_count || current_state.output >= state_count
+                    || current_state.depth != p_states[current_state.check].depth + 1
+                    || p_states[current_state.failure].depth >= current_state.depth || p_states[current_state.output].depth >= current_state.depth
+                    || (!(current_state.token_id == c_invalid_token_id) && !is_valid_token(current_state.token_id, static_cast<size_t>(current_state.depth))))
+                {
+                    throw std::invalid_argument("Failed to load the compiled tokens. A state is invalid.");
+                }
+            }
+        }
+
+        void throw_if_loaded() const
+        {
+            if (is_loaded())
+            {
+                throw std::logic_error("Failed to add token. The compiled tokens have been loaded, tokens cannot be added.");
+            }
+        }
+
+        template <typename text_wrapper_type>
+        void add_token_implementation(text_wrapper_type token_string, token_id_type token_id)
+        {
+            throw_if_loaded();
+            if (token_id == c_invalid_token_id)
+            {
+                throw std::invalid_argument("Failed to add token. Its token id is invalid.");
+            }
+
+            // We start with our root list of entries it contains the possible first characters of all tokens.
+            search_tree_entry_list_type* p_current_search_tree_entry_list = &tree.root;
+            // Go through the string of the token and add it to the search tree
+            for (text_wrapper_type character_of_token = token_string; !character_of_token.is_end_position(); ++character_of_token)
+            {
+                const char_type token_character = get_token_character(*character_of_token);
+                search_tree_entry_list_type* p_next_search_tree_entry_list = nullptr;
                 for (search_tree_entry& entry : *p_current_search_tree_entry_list)
                 {
                     // Is the character is already in our list?
-                    // We do not use the comparer here for adding tokens.
-                    if (entry.character == *character_of_token) // Existing search tree entry.
+                    // We do not use the comparer here for adding tokens, only the folded characters if it folds them.
+                    if (entry.character == token_character) // Existing search tree entry.
                     {
                         if (character_of_token.is_last_character()) // Last character of the new token?
                         {
@@ -403,13 +1570,17 @@ namespace cpptokenfinder
                 // Character not in list yet, new search tree entry.
                 if (p_next_search_tree_entry_list == nullptr)
                 {
+                    if (p_current_search_tree_entry_list == &tree.root)
+                    {
+                        add_first_character(token_character);
+                    }
                     if (character_of_token.is_last_character()) // Last character of the new token?
                     {
-                        p_current_search_tree_entry_list->emplace_back(*character_of_token, token_id);
+                        tree.add_entry(*p_current_search_tree_entry_list, token_character, token_id);
                     }
                     else // Not last character of the new token.
                     {
-                        p_current_search_tree_entry_list->emplace_back(*character_of_token, c_invalid_token_id);
+                        tree.add_entry(*p_current_search_tree_entry_list, token_character, c_invalid_token_id);
                     }
                     // Continue with the added entry.
                     p_next_search_tree_entry_list = &(p_current_search_tree_entry_list->back().next_entries);
@@ -417,54 +1588,870 @@ namespace cpptokenfinder
                 // Continue with the next search tree entry.
                 p_current_search_tree_entry_list = p_next_search_tree_entry_list;
             }
+            compiled = false;
+        }
+
+        typedef typename has_fold<comparer_type, char_type>::type folds_characters;
+
+        // Returns the character stored in the search tree for a token character.
+        char_type get_token_character(char_type character) const
+        {
+            return get_token_character(character, folds_characters());
+        }
+
+        char_type get_token_character(char_type character, std::true_type /*folds_characters*/) const
+        {
+            return comparer.fold(character);
+        }
+
+        char_type get_token_character(char_type character, std::false_type /*folds_characters*/) const
+        {
+            return character;
+        }
+
+        // Returns true if a character of the search tree matches a searched character returned by get_token_character().
+        bool is_matching_character(char_type token_character, char_type searched_character) const
+        {
+            return is_matching_character(token_character, searched_character, folds_characters());
+        }
+
+        bool is_matching_character(char_type token_character, char_type searched_character, std::true_type /*folds_characters*/) const
+        {
+            return token_character == searched_character;
+        }
+
+        bool is_matching_character(char_type token_character, char_type searched_character, std::false_type /*folds_characters*/) const
+        {
+            return comparer(token_character, searched_character);
+        }
+
+        // Adds the characters matching the first character of a token to the set of first characters.
+        void add_first_character(char_type character)
+        {
+            for (size_t value = 0; value < 256; ++value)
+            {
+                if (comparer(character, static_cast<char_type>(value)))
+                {
+                    first_characters.insert(value);
+                }
+            }
+        }
+
+        // Moves the text position to the next character that can start a token, returns the number of skipped characters.
+        template <typename text_wrapper_type>
+        size_t skip_to_first_character(text_wrapper_type& character_text) const
+        {
+            size_t skipped_characters = 0;
+            while (!character_text.is_end_position() && !first_characters.contains(*character_text))
+            {
+                ++character_text;
+                ++skipped_characters;
+            }
+            return skipped_characters;
+        }
+
+        // Texts given by character pointers are scanned by first_character_set::find().
+        template <typename pointer_char_type>
+        size_t skip_to_first_character(string_wrapper<pointer_char_type*>& character_text) const
+        {
+            pointer_char_type* p_first_character = character_text.pos + (first_characters.find(character_text.pos, character_text.end) - character_text.pos);
+            const size_t skipped_characters = static_cast<size_t>(p_first_character - character_text.pos);
+            character_text.pos = p_first_character;
+            return skipped_characters;
+        }
+
+        // Returns the class of a token character, characters matched by the same token characters share a class.
+        // Creates a new class for characters not matching any previous token character.
+        std::uint32_t get_token_character_class(char_type character, std::vector<std::uint32_t>& small_classes, std::map<char_type, std::uint32_t>& large_classes)
+        {
+            typedef typename std::make_unsigned<char_type>::type unsigned_char_type;
+            const size_t value = static_cast<size_t>(static_cast<unsigned_char_type>(character));
+            std::uint32_t* p_character_class = nullptr;
+            if (value < small_classes.size())
+            {
+                p_character_class = &small_classes[value];
+            }
+            else
+            {
+                p_character_class = &large_classes[character];
+            }
+            if (*p_character_class == 0)
+            {
+                *p_character_class = get_class_by_comparer(character);
+                if (*p_character_class == 0)
+                {
+                    class_characters.push_back(character);
+                    *p_character_class = static_cast<std::uint32_t>(class_characters.size());
+                }
+            }
+            return *p_character_class;
+        }
+
+        // Returns the class of the first token character matching the character, 0 if there is none.
+        std::uint32_t get_class_by_comparer(char_type character) const
+        {
+            return get_class_by_comparer(character, folds_characters());
+        }
+
+        // The classes of the folded characters are looked up in sorted_classes. While compile() creates the
+        // classes sorted_classes is empty, all folded token characters are different and get their own class.
+        std::uint32_t get_class_by_comparer(char_type character, std::true_type /*folds_characters*/) const
+        {
+            const std::pair<char_type, std::uint32_t> searched_class(comparer.fold(character), 0);
+            typename std::vector<std::pair<char_type, std::uint32_t>>::const_iterator found_class = std::lower_bound(sorted_classes.begin(), sorted_classes.end(), searched_class);
+            if (found_class != sorted_classes.end() && found_class->first == searched_class.first)
+            {
+                return found_class->second;
+            }
+            return 0;
+        }
+
+        std::uint32_t get_class_by_comparer(char_type character, std::false_type /*folds_characters*/) const
+        {
+            for (size_t i = 0; i < class_characters.size(); ++i)
+            {
+                if (comparer(class_characters[i], character))
+                {
+                    return static_cast<std::uint32_t>(i + 1);
+                }
+            }
+            return 0;
+        }
+
+        void create_sorted_classes(std::true_type /*folds_characters*/)
+        {
+            sorted_classes.reserve(class_characters.size());
+            for (size_t i = 0; i < class_characters.size(); ++i)
+            {
+                sorted_classes.emplace_back(class_characters[i], static_cast<std::uint32_t>(i + 1));
+            }
+            std::sort(sorted_classes.begin(), sorted_classes.end());
+        }
+
+        void create_sorted_classes(std::false_type /*folds_characters*/)
+        {
+            // The classes are found by comparing with each class character.
+        }
+
+        // Returns the class of a character of a searched text.
+        std::uint32_t get_character_class(char_type character) const
+        {
+            typedef typename std::make_unsigned<char_type>::type unsigned_char_type;
+            const size_t value = static_cast<size_t>(static_cast<unsigned_char_type>(character));
+            if (value < character_classes.size())
+            {
+                return character_classes[value];
+            }
+            return get_class_by_comparer(character);
+        }
+
+        // Returns the state reached from a state by a character class, following the failure links if the state
+        // cannot be continued by the character class.
+        std::uint32_t get_next_compiled_state(std::uint32_t state, std::uint32_t character_class) const
+        {
+            if (character_class == 0)
+            {
+                return 0; // No token contains the character.
+            }
+            const compiled_state* p_states = compiled_states.data();
+            const size_t state_count = compiled_states.size();
+            for (;;)
+            {
+                const size_t next_state = static_cast<size_t>(p_states[state].base) + character_class;
+                if (next_state < state_count && p_states[next_state].check == state)
+                {
+                    return static_cast<std::uint32_t>(next_state);
+                }
+                if (state == 0)
+                {
+                    return 0;
+                }
+                state = p_states[state].failure;
+            }
         }
 
         template <typename text_wrapper_type, typename iterator_type>
         bool find_token_implementation(text_wrapper_type text, iterator_type& token_begin_out, iterator_type& token_end_out, token_id_type& token_id_out) const
         {
+            if (compiled)
+            {
+                return find_token_compiled_implementation(text, token_begin_out, token_end_out, token_id_out);
+            }
+
             bool result = false;
             // Go through the string and search for matching tokens using the search tree.
             for (text_wrapper_type character_text = text; !character_text.is_end_position() && !result; ++character_text)
             {
-                // We start with our root list of entries it contains the possible first characters of all tokens.
-                const search_tree_entry_list_type* p_current_search_tree_entry_list = &root;
-                // Look for a token using the search tree
-                for (text_wrapper_type character_token = character_text; !character_token.is_end_position(); ++character_token)
+                // Skip the characters that cannot start a token.
+                skip_to_first_character(character_text);
+                if (character_text.is_end_position())
                 {
-                    const search_tree_entry_list_type* p_next_search_tree_entry_list = nullptr;
-                    for (const search_tree_entry& entry : *p_current_search_tree_entry_list)
-                    {
-                        // Is the character in our list?
-                        if (comparer(entry.character, *character_token))
-                        {
-                            p_next_search_tree_entry_list = &entry.next_entries;
-                            // Found a token?
-                            if (!(entry.token_id == c_invalid_token_id))
-                            {
-                                result = true;
-                                token_begin_out = character_text.get_position();
-                                token_end_out = character_token.get_position() + 1; // The end position is one character past the last character.
-                                token_id_out = entry.token_id;
-                                // We keep on searching in case there is a longer token to match.
-                            }
-                            break;
-                        }
-                    }
-                    if (p_next_search_tree_entry_list == nullptr) // No further character matched.
-                    {
-                        break;
-                    }
-                    else
-                    {
-                        p_current_search_tree_entry_list = p_next_search_tree_entry_list;
-                    }
+                    break;
+                }
+                if (find_longest_token_at(character_text, token_end_out, token_id_out))
+                {
+                    result = true;
+                    token_begin_out = character_text.get_position();
                 }
             }
             return result;
         }
 
-    protected:
-        search_tree_entry_list_type root;
+        // Finds the longest token starting at the text position using the search tree.
+        template <typename text_wrapper_type, typename iterator_type>
+        bool find_longest_token_at(text_wrapper_type character_text, iterator_type& token_end_out, token_id_type& token_id_out) const
+        {
+            longest_token_handler<iterator_type> handler(token_end_out, token_id_out);
+            for_each_tree_token_at(character_text, handler);
+            return handler.found;
+        }
+
+        // Finds the longest token starting at the text position using the states of the compiled search tree.
+        template <typename text_wrapper_type, typename iterator_type>
+        bool find_longest_compiled_token_at(text_wrapper_type character_text, iterator_type& token_end_out, token_id_type& token_id_out) const
+        {
+            longest_token_handler<iterator_type> handler(token_end_out, token_id_out);
+            for_each_compiled_token_at(character_text, handler);
+            return handler.found;
+        }
+
+        // Calls handler(token_id, token_end) for each token starting at the text position, the shortest token first.
+        template <typename text_wrapper_type, typename handler_type>
+        void for_each_token_at(text_wrapper_type character_text, handler_type& handler) const
+        {
+            if (compiled)
+            {
+                for_each_compiled_token_at(character_text, handler);
+            }
+            else
+            {
+                for_each_tree_token_at(character_text, handler);
+            }
+        }
+
+        template <typename text_wrapper_type, typename handler_type>
+        void for_each_tree_token_at(text_wrapper_type character_text, handler_type& handler) const
+        {
+            // We start with our root list of entries it contains the possible first characters of all tokens.
+            const search_tree_entry_list_type* p_current_search_tree_entry_list = &tree.root;
+            // Look for a token using the search tree
+            for (text_wrapper_type character_token = character_text; !character_token.is_end_position(); ++character_token)
+            {
+                // The character is folded once, not for every entry it is compared with.
+                const char_type searched_character = get_token_character(*character_token);
+                const search_tree_entry_list_type* p_next_search_tree_entry_list = nullptr;
+                for (const search_tree_entry& entry : *p_current_search_tree_entry_list)
+                {
+                    // Is the character in our list?
+                    if (is_matching_character(entry.character, searched_character))
+                    {
+                        p_next_search_tree_entry_list = &entry.next_entries;
+                        // Found a token?
+                        if (!(entry.token_id == c_invalid_token_id))
+                        {
+                            // The end position is one character past the last character.
+                            handler(entry.token_id, character_token.get_position() + 1);
+                            // We keep on searching in case there is a longer token to match.
+                        }
+                        break;
+                    }
+                }
+                if (p_next_search_tree_entry_list == nullptr) // No further character matched.
+                {
+                    break;
+                }
+                else
+                {
+                    p_current_search_tree_entry_list = p_next_search_tree_entry_list;
+                }
+            }
+        }
+
+        // Only the next states are followed, not the failure links.
+        template <typename text_wrapper_type, typename handler_type>
+        void for_each_compiled_token_at(text_wrapper_type character_text, handler_type& handler) const
+        {
+            const compiled_state* p_states = compiled_states.data();
+            const size_t state_count = compiled_states.size();
+            size_t state = 0; // The root.
+            for (text_wrapper_type character_token = character_text; !character_token.is_end_position(); ++character_token)
+            {
+                const std::uint32_t character_class = get_character_class(*character_token);
+                const size_t next_state = static_cast<size_t>(p_states[state].base) + character_class;
+                if (character_class == 0 || next_state >= state_count || p_states[next_state].check != state)
+                {
+                    break;
+                }
+                state = next_state;
+                if (!(p_states[state].token_id == c_invalid_token_id))
+                {
+                    // The end position is one character past the last character.
+                    handler(p_states[state].token_id, character_token.get_position() + 1);
+                }
+            }
+        }
+
+        template <typename text_wrapper_type, typename iterator_type, typename filter_type>
+        bool find_ranked_token_at_implementation(text_wrapper_type text, const filter_type& filter, iterator_type& token_end_out, token_id_type& token_id_out) const
+        {
+            ranked_token_handler<iterator_type, filter_type> handler(filter, text.get_position());
+            for_each_token_at(text, handler);
+            if (handler.rank != 0)
+            {
+                token_end_out = handler.token_end;
+                token_id_out = handler.token_id;
+                return true;
+            }
+            return false;
+        }
+
+        template <typename text_wrapper_type, typename iterator_type, typename filter_type>
+        bool find_ranked_token_implementation(text_wrapper_type text, const filter_type& filter, iterator_type& token_begin_out, iterator_type& token_end_out, token_id_type& token_id_out) const
+        {
+            // Go through the string and collect the tokens at each position until one is accepted by the filter.
+            for (text_wrapper_type character_text = text; !character_text.is_end_position(); ++character_text)
+            {
+                // Skip the characters that cannot start a token.
+                skip_to_first_character(character_text);
+                if (character_text.is_end_position())
+                {
+                    break;
+                }
+                ranked_token_handler<iterator_type, filter_type> handler(filter, character_text.get_position());
+                for_each_token_at(character_text, handler);
+                if (handler.rank != 0)
+                {
+                    token_begin_out = character_text.get_position();
+                    token_end_out = handler.token_end;
+                    token_id_out = handler.token_id;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        template <typename text_wrapper_type, typename iterator_type>
+        bool find_token_compiled_implementation(text_wrapper_type text, iterator_type& token_begin_out, iterator_type& token_end_out, token_id_type& token_id_out) const
+        {
+            bool result = false;
+            size_t text_position = 0; // Number of characters consumed so far.
+            size_t token_begin_position = 0; // Start of the best token found so far.
+            const compiled_state* p_states = compiled_states.data();
+            std::uint32_t state = 0; // The root.
+            // Go through the string once, the current state is the longest suffix of the consumed text in the search tree.
+            for (text_wrapper_type character_text = text; !character_text.is_end_position(); ++character_text)
+            {
+                if (state == 0)
+                {
+                    // No partial match, skip the characters that cannot start a token.
+                    text_position += skip_to_first_character(character_text);
+                    if (character_text.is_end_position())
+                    {
+                        break;
+                    }
+                }
+                state = get_next_compiled_state(state, get_character_class(*character_text));
+                ++text_position;
+
+                // The current state or the first state on its output chain is the longest token ending here, i.e.
+                // the one starting leftmost. It replaces a found token if it starts before or at the same position.
+                std::uint32_t token_state = (p_states[state].token_id == c_invalid_token_id) ? p_states[state].output : state;
+                if (token_state != 0 && (!result || text_position - p_states[token_state].depth <= token_begin_position))
+                {
+                    result = true;
+                    token_begin_position = text_position - p_states[token_state].depth;
+                    token_begin_out = character_text.get_position() - static_cast<std::ptrdiff_t>(p_states[token_state].depth - 1);
+                    token_end_out = character_text.get_position() + 1; // The end position is one character past the last character.
+                    token_id_out = p_states[token_state].token_id;
+                }
+
+                // We are done if no partial match starting at or before the found token is left.
+                if (result && text_position - p_states[state].depth > token_begin_position)
+                {
+                    break;
+                }
+            }
+            return result;
+        }
+
+    protected:
+        search_tree tree;
         comparer_type comparer;
+        first_character_set<char_type> first_characters; // The characters matching the first character of a token.
+        bool compiled = false;
+        mappable_vector<compiled_state> compiled_states; // Refers to the memory given to load_compiled() if loaded.
+        std::vector<std::uint32_t> character_classes; // Class of the characters 0 to 255, 0 if no token contains the character.
+        std::vector<char_type> class_characters; // The first token character of each class, index is class - 1.
+        std::vector<std::pair<char_type, std::uint32_t>> sorted_classes; // Folded token characters and their classes, sorted.
+    };
+
+    template <typename char_type, typename token_id_type, typename invalid_token_id_type, invalid_token_id_type c_invalid_token_id, typename comparer_type>
+    const std::uint32_t token_finder<char_type, token_id_type, invalid_token_id_type, c_invalid_token_id, comparer_type>::c_no_state;
+
+    /**
+       \brief A token finder for large sets of tokens filtering the text by the first characters of the tokens.
+       After compile() the text positions are compared with a fingerprint of the first characters of all tokens,
+       up to four, similar to the Teddy algorithm. The fingerprint distributes the tokens to eight buckets, a text
+       position is a candidate if its characters match the fingerprint of the same bucket at each fingerprint
+       character. As the buckets of thousands of tokens match almost any text, the candidates are also looked up in
+       a hashed bit set of the token prefixes, similar to the FDR algorithm. Only the remaining candidates are
+       searched using the compiled search tree. The fingerprint is compared for 32 text characters at a time using
+       AVX2 instructions if available, define CPPTOKENFINDER_NO_SIMD to use the scalar comparison only.
+
+       The fingerprint is used for texts of single byte characters given by character pointers, other texts are
+       searched like by a compiled token_finder. The found tokens are the same as the ones found by token_finder.
+       The template parameters are the ones of token_finder.
+    */
+    template <typename char_type, typename token_id_type, typename invalid_token_id_type, invalid_token_id_type c_invalid_token_id, typename comparer_type = token_finder_default_comparer>
+    class teddy_token_finder : public token_finder<char_type, token_id_type, invalid_token_id_type, c_invalid_token_id, comparer_type>
+    {
+        typedef token_finder<char_type, token_id_type, invalid_token_id_type, c_invalid_token_id, comparer_type> base_type;
+        typedef typename base_type::search_tree_entry search_tree_entry;
+        typedef typename base_type::search_tree_entry_list_type search_tree_entry_list_type;
+
+        static const size_t c_max_fingerprint_length = 4;
+        static const size_t c_bucket_count = 8;
+        static const size_t c_max_prefix_variants = 64; // Maximum number of text prefixes matching a token prefix.
+        static const size_t c_terminator_search_length = 1024; // Characters of a null-terminated text checked for the end at a time.
+
+    public:
+        teddy_token_finder()
+        {
+            clear_fingerprint();
+        }
+
+        using base_type::find_token;
+
+        /**
+            \copydoc token_finder::find_token()
+        */
+        bool find_token(const char_type* text, const char_type*& token_begin_out, const char_type*& token_end_out, token_id_type& token_id_out) const
+        {
+            if (text == nullptr || !has_fingerprint())
+            {
+                return base_type::find_token(text, token_begin_out, token_end_out, token_id_out);
+            }
+            return find_token_by_fingerprint(text, token_begin_out, token_end_out, token_id_out);
+        }
+
+        /**
+            \copydoc token_finder::find_token()
+        */
+        bool find_token(char_type* text, char_type*& token_begin_out, char_type*& token_end_out, token_id_type& token_id_out) const
+        {
+            if (text == nullptr || !has_fingerprint())
+            {
+                return base_type::find_token(text, token_begin_out, token_end_out, token_id_out);
+            }
+            return find_token_by_fingerprint(text, token_begin_out, token_end_out, token_id_out);
+        }
+
+        /**
+            \copydoc token_finder::find_token(iterator_type,iterator_type,iterator_type&,iterator_type&,token_id_type&)const
+        */
+        bool find_token(const char_type* text_begin, const char_type* text_end, const char_type*& token_begin_out, const char_type*& token_end_out, token_id_type& token_id_out) const
+        {
+            if (!has_fingerprint())
+            {
+                return base_type::find_token(text_begin, text_end, token_begin_out, token_end_out, token_id_out);
+            }
+            return find_token_by_fingerprint(text_begin, text_end, std::false_type(), token_begin_out, token_end_out, token_id_out);
+        }
+
+        /**
+            \copydoc token_finder::find_token(iterator_type,iterator_type,iterator_type&,iterator_type&,token_id_type&)const
+        */
+        bool find_token(char_type* text_begin, char_type* text_end, char_type*& token_begin_out, char_type*& token_end_out, token_id_type& token_id_out) const
+        {
+            if (!has_fingerprint())
+            {
+                return base_type::find_token(text_begin, text_end, token_begin_out, token_end_out, token_id_out);
+            }
+            return find_token_by_fingerprint(text_begin, text_end, std::false_type(), token_begin_out, token_end_out, token_id_out);
+        }
+
+        /**
+            \brief Clears all tokens added using add_token().
+        */
+        void clear()
+        {
+            base_type::clear();
+            clear_fingerprint();
+        }
+
+        /**
+            \brief Compiles the added tokens and creates the fingerprint of their first characters.
+            \copydetails token_finder::compile()
+        */
+        void compile()
+        {
+            clear_fingerprint();
+            base_type::compile();
+            create_fingerprint(std::integral_constant<bool, sizeof(char_type) == 1>());
+        }
+
+        /**
+            \copydoc token_finder::load_compiled(const char*,const char*)
+        */
+        const char* load_compiled(const char* data, const char* data_end)
+        {
+            clear_fingerprint();
+            return base_type::load_compiled(data, data_end);
+        }
+
+        /**
+            \copydoc token_finder::load_compiled(const char*,const char*,const validator_type&)
+        */
+        template <typename validator_type>
+        const char* load_compiled(const char* data, const char* data_end, const validator_type& is_valid_token)
+        {
+            clear_fingerprint();
+            return base_type::load_compiled(data, data_end, is_valid_token);
+        }
+
+        /**
+            \brief Returns the memory used by the compiled search and the fingerprint in bytes, 0 if not compiled.
+        */
+        size_t compiled_size_in_bytes() const
+        {
+            return base_type::compiled_size_in_bytes() + (has_fingerprint() ? sizeof(bucket_masks) + sizeof(low_nibble_masks) + sizeof(high_nibble_masks) + prefix_bits.capacity() * sizeof(std::uint64_t) : 0);
+        }
+
+        /**
+            \brief Returns the number of first token characters compared by the fingerprint, 0 if there is no fingerprint.
+        */
+        size_t get_fingerprint_length() const
+        {
+            return has_fingerprint() ? fingerprint_length : 0;
+        }
+
+    private:
+        bool has_fingerprint() const
+        {
+            return this->compiled && fingerprint_length != 0;
+        }
+
+        void clear_fingerprint()
+        {
+            fingerprint_length = 0;
+            std::fill(&bucket_masks[0][0], &bucket_masks[0][0] + sizeof(bucket_masks), static_cast<unsigned char>(0));
+            std::fill(&low_nibble_masks[0][0], &low_nibble_masks[0][0] + sizeof(low_nibble_masks), static_cast<unsigned char>(0));
+            std::fill(&high_nibble_masks[0][0], &high_nibble_masks[0][0] + sizeof(high_nibble_masks), static_cast<unsigned char>(0));
+            prefix_mask = 0;
+            prefix_bits.clear();
+            prefix_hash_shift = 0;
+        }
+
+        void create_fingerprint(std::false_type /*single_byte*/)
+        {
+            // Texts of wider characters are searched without fingerprint.
+        }
+
+        void create_fingerprint(std::true_type /*single_byte*/)
+        {
+            // Every token must be at least as long as the fingerprint, otherwise its position would not be a candidate.
+            size_t length = c_max_fingerprint_length;
+            get_minimum_token_length(this->tree.root, 1, length);
+
+            // The distinct prefixes of the fingerprint length, in lexicographic order, so similar prefixes share a bucket.
+            std::vector<std::uint32_t> prefixes;
+            collect_prefixes(this->tree.root, 0, length, 0, prefixes);
+            if (prefixes.empty())
+            {
+                return;
+            }
+            std::sort(prefixes.begin(), prefixes.end());
+            prefixes.erase(std::unique(prefixes.begin(), prefixes.end()), prefixes.end());
+
+            // The text characters matched by each token character, see the comparer.
+            std::vector<std::vector<unsigned char>> matching_characters(256);
+            for (size_t character = 0; character < 256; ++character)
+            {
+                for (size_t value = 0; value < 256; ++value)
+                {
+                    if (this->comparer(static_cast<char_type>(character), static_cast<char_type>(value)))
+                    {
+                        matching_characters[character].push_back(static_cast<unsigned char>(value));
+                    }
+                }
+            }
+
+            for (size_t i = 0; i < prefixes.size(); ++i)
+            {
+                const unsigned char bucket_bit = static_cast<unsigned char>(1u << (i * c_bucket_count / prefixes.size()));
+                for (size_t position = 0; position < length; ++position)
+                {
+                    for (unsigned char value : matching_characters[get_prefix_character(prefixes[i], length, position)])
+                    {
+                        bucket_masks[position][value] |= bucket_bit;
+                    }
+                }
+            }
+            // The characters after the fingerprint match all buckets, so four characters can always be compared.
+            std::fill(&bucket_masks[0][0] + length * 256, &bucket_masks[0][0] + sizeof(bucket_masks), static_cast<unsigned char>(0xFF));
+            for (size_t position = 0; position < c_max_fingerprint_length; ++position)
+            {
+                for (size_t value = 0; value < 256; ++value)
+                {
+                    low_nibble_masks[position][value & 0x0F] |= bucket_masks[position][value];
+                    high_nibble_masks[position][value >> 4] |= bucket_masks[position][value];
+                }
+            }
+            fingerprint_length = length;
+            prefix_mask = static_cast<std::uint32_t>((static_cast<std::uint64_t>(1) << (8 * length)) - 1);
+            create_prefix_bits(prefixes, matching_characters);
+        }
+
+        static void get_minimum_token_length(const search_tree_entry_list_type& entries, size_t depth, size_t& length)
+        {
+            if (depth >= length)
+            {
+                return;
+            }
+            for (const search_tree_entry& entry : entries)
+            {
+                if (!(entry.token_id == c_invalid_token_id))
+                {
+                    length = depth;
+                }
+                else
+                {
+                    get_minimum_token_length(entry.next_entries, depth + 1, length);
+                }
+            }
+        }
+
+        // Collects the prefixes of the given length, the first character is stored in the highest used byte.
+        static void collect_prefixes(const search_tree_entry_list_type& entries, size_t depth, size_t length, std::uint32_t prefix, std::vector<std::uint32_t>& prefixes)
+        {
+            for (const search_tree_entry& entry : entries)
+            {
+                const std::uint32_t next_prefix = (prefix << 8) | static_cast<unsigned char>(entry.character);
+                if (depth + 1 == length)
+                {
+                    prefixes.push_back(next_prefix);
+                }
+                else
+                {
+                    collect_prefixes(entry.next_entries, depth + 1, length, next_prefix, prefixes);
+                }
+            }
+        }
+
+        static size_t get_prefix_character(std::uint32_t prefix, size_t length, size_t position)
+        {
+            return (prefix >> (8 * (length - 1 - position))) & 0xFF;
+        }
+
+        // Adds all text prefixes matching the token prefixes to the hashed bit set. All bits are set if a token
+        // prefix matches too many text prefixes, e.g. because of a wildcard comparer.
+        void create_prefix_bits(const std::vector<std::uint32_t>& prefixes, const std::vector<std::vector<unsigned char>>& matching_characters)
+        {
+            // The text prefixes are stored like read by is_candidate(), the first character in the lowest byte.
+            std::vector<std::uint32_t> text_prefixes;
+            bool too_many_variants = false;
+            for (size_t i = 0; i < prefixes.size() && !too_many_variants; ++i)
+            {
+                const size_t first_text_prefix = text_prefixes.size();
+                text_prefixes.push_back(0);
+                for (size_t position = 0; position < fingerprint_length && !too_many_variants; ++position)
+                {
+                    const std::vector<unsigned char>& characters = matching_characters[get_prefix_character(prefixes[i], fingerprint_length, position)];
+                    const size_t variant_count = text_prefixes.size() - first_text_prefix;
+                    too_many_variants = variant_count * characters.size() > c_max_prefix_variants;
+                    for (size_t variant = 0; variant < variant_count && !too_many_variants; ++variant)
+                    {
+                        const std::uint32_t text_prefix = text_prefixes[first_text_prefix + variant];
+                        text_prefixes[first_text_prefix + variant] = text_prefix | (static_cast<std::uint32_t>(characters[0]) << (8 * position));
+                        for (size_t character = 1; character < characters.size(); ++character)
+                        {
+                            text_prefixes.push_back(text_prefix | (static_cast<std::uint32_t>(characters[character]) << (8 * position)));
+                        }
+                    }
+                }
+            }
+            if (too_many_variants)
+            {
+                prefix_hash_shift = 26;
+                prefix_bits.assign(1, ~static_cast<std::uint64_t>(0));
+                return;
+            }
+
+            // About 32 bits per text prefix, so few other text prefixes share a bit, at most 1 MiB.
+            unsigned int size_log2 = 10;
+            while (size_log2 < 23 && (static_cast<size_t>(1) << size_log2) < text_prefixes.size() * 32)
+            {
+                ++size_log2;
+            }
+            prefix_hash_shift = 32 - size_log2;
+            prefix_bits.assign((static_cast<size_t>(1) << size_log2) / 64, 0);
+            for (std::uint32_t text_prefix : text_prefixes)
+            {
+                const std::uint32_t hash = get_prefix_hash(text_prefix);
+                prefix_bits[hash / 64] |= static_cast<std::uint64_t>(1) << (hash % 64);
+            }
+        }
+
+        std::uint32_t get_prefix_hash(std::uint32_t text_prefix) const
+        {
+            return static_cast<std::uint32_t>(text_prefix * 2654435761u) >> prefix_hash_shift;
+        }
+
+        // Returns true if the four characters at the text position match the fingerprint of a bucket and the text
+        // prefix is in the hashed bit set. Computed without branches, as most text positions are no candidates.
+        bool is_candidate(const unsigned char* p) const
+        {
+            const unsigned int buckets = bucket_masks[0][p[0]] & bucket_masks[1][p[1]] & bucket_masks[2][p[2]] & bucket_masks[3][p[3]];
+            const std::uint32_t text_prefix = (static_cast<std::uint32_t>(p[0]) | (static_cast<std::uint32_t>(p[1]) << 8) | (static_cast<std::uint32_t>(p[2]) << 16) | (static_cast<std::uint32_t>(p[3]) << 24)) & prefix_mask;
+            const std::uint32_t hash = get_prefix_hash(text_prefix);
+            return ((static_cast<unsigned int>(buckets != 0) & static_cast<unsigned int>(prefix_bits[hash / 64] >> (hash % 64))) & 1) != 0;
+        }
+
+        // Like is_candidate() for text positions followed by less than four characters.
+        bool is_candidate(const unsigned char* p, const unsigned char* p_end) const
+        {
+            if (p_end - p >= static_cast<std::ptrdiff_t>(c_max_fingerprint_length))
+            {
+                return is_candidate(p);
+            }
+            unsigned char characters[c_max_fingerprint_length] = {};
+            std::copy(p, p_end, characters);
+            return is_candidate(characters);
+        }
+
+        // Searches a null-terminated text block by block. The end of the text is looked for in the next block only,
+        // so the search does not depend on the length of the text after the found token.
+        template <typename pointer_char_type>
+        bool find_token_by_fingerprint(pointer_char_type* text, pointer_char_type*& token_begin_out, pointer_char_type*& token_end_out, token_id_type& token_id_out) const
+        {
+            for (;;)
+            {
+                // memchr() stops at the first null character, so no character after the end of the text is read.
+                const void* terminator = std::memchr(text, 0, c_terminator_search_length);
+                if (terminator != nullptr)
+                {
+                    pointer_char_type* text_end = text + (static_cast<const char*>(terminator) - reinterpret_cast<const char*>(text));
+                    return find_token_by_fingerprint(text, text_end, std::false_type(), token_begin_out, token_end_out, token_id_out);
+                }
+                // Tokens may continue after the block, the positions whose fingerprint does not fit are searched with the next block.
+                pointer_char_type* block_end = text + c_terminator_search_length;
+                if (find_token_by_fingerprint(text, block_end, std::true_type(), token_begin_out, token_end_out, token_id_out))
+                {
+                    return true;
+                }
+                text = block_end - (fingerprint_length - 1);
+            }
+        }
+
+        // Searches the candidate positions whose fingerprint is within the text range. If null_terminated is true, the
+        // range is a block of a null-terminated text and the found tokens may end after the block.
+        template <typename pointer_char_type, typename null_terminated_type>
+        bool find_token_by_fingerprint(pointer_char_type* text_begin, pointer_char_type* text_end, null_terminated_type null_terminated, pointer_char_type*& token_begin_out, pointer_char_type*& token_end_out, token_id_type& token_id_out) const
+        {
+            const unsigned char* const p_begin = reinterpret_cast<const unsigned char*>(text_begin);
+            const unsigned char* const p_end = reinterpret_cast<const unsigned char*>(text_end);
+            const unsigned char* p = p_begin;
+            if (static_cast<size_t>(p_end - p) < fingerprint_length)
+            {
+                return false;
+            }
+            // The last position a token can start at.
+            const unsigned char* const p_last = p_end - fingerprint_length;
+#if defined(CPPTOKENFINDER_AVX2)
+            // Looks up the buckets of the low and the high nibble of each fingerprint character, 32 positions at a time.
+            if (p_end - p >= static_cast<std::ptrdiff_t>(32 + c_max_fingerprint_length - 1))
+            {
+                __m256i low_tables[c_max_fingerprint_length];
+                __m256i high_tables[c_max_fingerprint_length];
+                for (size_t position = 0; position < c_max_fingerprint_length; ++position)
+                {
+                    low_tables[position] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(low_nibble_masks[position])));
+                    high_tables[position] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(high_nibble_masks[position])));
+                }
+                const __m256i nibble_mask = _mm256_set1_epi8(0x0F);
+                const __m256i zero = _mm256_setzero_si256();
+                for (; p_end - p >= static_cast<std::ptrdiff_t>(32 + c_max_fingerprint_length - 1); p += 32)
+                {
+                    __m256i buckets = _mm256_set1_epi8(-1);
+                    for (size_t position = 0; position < fingerprint_length; ++position)
+                    {
+                        const __m256i text = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + position));
+                        const __m256i low_buckets = _mm256_shuffle_epi8(low_tables[position], _mm256_and_si256(text, nibble_mask));
+                        const __m256i high_buckets = _mm256_shuffle_epi8(high_tables[position], _mm256_and_si256(_mm256_srli_epi16(text, 4), nibble_mask));
+                        buckets = _mm256_and_si256(buckets, _mm256_and_si256(low_buckets, high_buckets));
+                    }
+                    unsigned int candidates = ~static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(buckets, zero)));
+                    while (candidates != 0)
+                    {
+                        // The nibbles may match different tokens of a bucket, the exact fingerprint is checked first.
+                        const unsigned char* p_candidate = p + get_lowest_bit_index(candidates);
+                        if (is_candidate(p_candidate) && find_token_at(text_begin + (p_candidate - p_begin), text_end, null_terminated, token_begin_out, token_end_out, token_id_out))
+                        {
+                            return true;
+                        }
+                        candidates &= candidates - 1;
+                    }
+                }
+            }
+#endif
+            if (this->first_characters.size() <= c_bucket_count)
+            {
+                // Few characters start a token, skip the others.
+                for (;; ++p)
+                {
+                    p = reinterpret_cast<const unsigned char*>(this->first_characters.find(text_begin + (p - p_begin), text_begin + (p_last - p_begin) + 1));
+                    if (p > p_last)
+                    {
+                        break;
+                    }
+                    if (is_candidate(p, p_end) && find_token_at(text_begin + (p - p_begin), text_end, null_terminated, token_begin_out, token_end_out, token_id_out))
+                    {
+                        return true;
+                    }
+                }
+            }
+            else
+            {
+                for (; p <= p_last; ++p)
+                {
+                    if (is_candidate(p, p_end) && find_token_at(text_begin + (p - p_begin), text_end, null_terminated, token_begin_out, token_end_out, token_id_out))
+                    {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        // Searches the longest token starting at a candidate position using the compiled search tree.
+        template <typename pointer_char_type>
+        bool find_token_at(pointer_char_type* candidate, pointer_char_type* text_end, std::false_type /*null_terminated*/, pointer_char_type*& token_begin_out, pointer_char_type*& token_end_out, token_id_type& token_id_out) const
+        {
+            if (this->find_longest_compiled_token_at(typename base_type::template string_wrapper<pointer_char_type*>(candidate, text_end), token_end_out, token_id_out))
+            {
+                token_begin_out = candidate;
+                return true;
+            }
+            return false;
+        }
+
+        template <typename pointer_char_type>
+        bool find_token_at(pointer_char_type* candidate, pointer_char_type* /*block_end*/, std::true_type /*null_terminated*/, pointer_char_type*& token_begin_out, pointer_char_type*& token_end_out, token_id_type& token_id_out) const
+        {
+            if (this->find_longest_compiled_token_at(typename base_type::template null_terminated_string_wrapper<pointer_char_type>(candidate), token_end_out, token_id_out))
+            {
+                token_begin_out = candidate;
+                return true;
+            }
+            return false;
+        }
+
+        size_t fingerprint_length; // Number of compared first token characters, 0 if there is no fingerprint.
+        unsigned char bucket_masks[c_max_fingerprint_length][256]; // Buckets matching a character at each fingerprint position.
+        unsigned char low_nibble_masks[c_max_fingerprint_length][16]; // Buckets matching a low nibble at each fingerprint position.
+        unsigned char high_nibble_masks[c_max_fingerprint_length][16]; // Buckets matching a high nibble at each fingerprint position.
+        std::uint32_t prefix_mask; // The bits of the fingerprint characters in a text prefix.
+        std::vector<std::uint64_t> prefix_bits; // Hashed bit set of the text prefixes matching a token prefix.
+        unsigned int prefix_hash_shift; // 32 - log2 of the number of bits of prefix_bits.
     };
 }
@@ -73,17 +73,35 @@ find and the text to replace it with.
   underscores. It is replaced by the modified replacement text to match the found
   casing.
 
-1. In preserve case mode, the text to find is separated into words.
-2. A list of all casing variants of the text to find and the text to replace is
-   built.
-3. Then the source text is parsed and the replacements are executed.
+1. In preserve case mode, the text to find is separated into words and stored
+   once.
+2. The words are searched ignoring the case, the separators are equal to each
+   other.
+3. Then the source text is parsed. The casing of each found text is determined
+   and the replacement text is written in the same casing.
 */
 #pragma once
 #include "cpptokenfinder.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <initializer_list>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#if (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L
+#include <string_view>
+#define ROBOLINA_HAS_STRING_VIEW
+#define ROBOLINA_HAS_INLINE_VARIABLES
+#endif
+
 namespace robolina
 {
     enum class case_mode
@@ -120,12 +138,122 @@ namespace robolina
      * \endcode
      *
      * \tparam char_type The character type to use (char, wchar_t, etc.)
+     * \tparam token_id_type The unsigned integral type identifying the texts to find internally. A preserve case
+     *         replacement of several words uses two texts to find. A smaller type uses less memory for large rule
+     *         sets, e.g. std::uint16_t allows up to 65534 texts to find.
      */
-    template<typename char_type>
+    template<typename char_type, typename token_id_type = std::uint32_t>
     class case_preserve_replacer
     {
-        typedef size_t token_id_type;
+        static_assert(std::is_integral<token_id_type>::value && std::is_unsigned<token_id_type>::value, "The token ID type must be an unsigned integral type.");
     public:
+        /**
+         * \brief The memory used by a replacer in bytes, see get_memory_usage().
+         */
+        struct memory_usage
+        {
+            size_t search_tree; //!< The search tree of the texts to find.
+            size_t compiled; //!< The state tables created by compile(), 0 if the replacer is not compiled.
+            size_t replacements; //!< The texts to find and the replacement texts.
+
+            size_t total() const
+            {
+                return search_tree + compiled + replacements;
+            }
+        };
+
+        /**
+         * \brief A text to replace, found by find_edits().
+         */
+        struct edit
+        {
+            size_t offset; //!< The position of the found text in characters from the text begin.
+            size_t length; //!< The length of the found text in characters.
+            size_t replacement_id; //!< Identifies the replacement text, see get_replacement_text().
+        };
+
+        /**
+         * \brief A replacement rule, see add_replacements().
+         */
+        struct replacement
+        {
+            std::basic_string<char_type> text_to_find; //!< The text to search for in the source text.
+            std::basic_string<char_type> replacement_text; //!< The text to replace the found text with.
+            case_mode mode; //!< The case handling mode to use for this replacement.
+            bool match_whole_word; //!< If true, only match whole words, see add_replacement().
+        };
+
+        /**
+         * \brief A text of the replacer, see get_replacement_text().
+         *
+         * A text stored in the replacer is not copied, it is valid until the next replacement is added or the replacer is
+         * destroyed. A preserve case replacement text is written in the casing of the found text, the range holds it.
+         */
+        class text_range
+        {
+        public:
+            text_range(const char_type* begin_of_text, const char_type* end_of_text)
+                : text_begin(begin_of_text)
+                , text_end(end_of_text)
+            {
+            }
+
+            explicit text_range(std::basic_string<char_type>&& text)
+                : owned_text(std::move(text))
+                , is_owned(true)
+            {
+                set_range(*this);
+            }
+
+            text_range(const text_range& other)
+                : owned_text(other.owned_text)
+                , is_owned(other.is_owned)
+            {
+                set_range(other);
+            }
+
+            text_range& operator=(const text_range& other)
+            {
+                owned_text = other.owned_text;
+                is_owned = other.is_owned;
+                set_range(other);
+                return *this;
+            }
+
+            const char_type* begin() const { return text_begin; }
+            const char_type* end() const { return text_end; }
+            const char_type* data() const { return text_begin; }
+            size_t size() const { return static_cast<size_t>(text_end - text_begin); }
+
+            std::basic_string<char_type> to_string() const
+            {
+                return std::basic_string<char_type>(text_begin, text_end);
+            }
+
+            bool operator==(const std::basic_string<char_type>& text) const
+            {
+                return text.size() == size() && std::equal(text_begin, text_end, text.begin());
+            }
+
+            bool operator==(const char_type* text) const
+            {
+                return std::char_traits<char_type>::length(text) == size() && std::equal(text_begin, text_end, text);
+            }
+
+        private:
+            // An owned text is referred to in this range, not in the copied one.
+            void set_range(const text_range& other)
+            {
+                text_begin = is_owned ? owned_text.data() : other.text_begin;
+                text_end = is_owned ? owned_text.data() + owned_text.size() : other.text_end;
+            }
+
+            const char_type* text_begin = nullptr;
+            const char_type* text_end = nullptr;
+            std::basic_string<char_type> owned_text; //!< The text if it is not stored in the replacer.
+            bool is_owned = false;
+        };
+
         /**
          * \brief Adds a replacement rule to the replacer.
          *
@@ -137,53 +265,221 @@ namespace robolina
          * \param mode The case handling mode to use for this replacement.
          * \param match_whole_word If true, only match whole words bounded by non-alphanumeric characters.
          * \throws std::invalid_argument If text_to_find is null or empty, or replacement_text is null.
+         * \throws std::length_error If there are more texts to find than the token ID type can identify.
+         * \throws std::logic_error If the replacer has been loaded, see load_compiled().
          */
         void add_replacement(const char_type* text_to_find, const char_type* replacement_text, case_mode mode, bool match_whole_word = false)
         {
-            if (text_to_find == nullptr)
+            add_replacement_implementation(text_to_find, replacement_text, mode, match_whole_word, nullptr);
+        }
+
+        /**
+         * \brief Adds several replacement rules to the replacer.
+         *
+         * The rules are added like by calling add_replacement() for each of them in the given order, this is
+         * faster for large rule sets. The duplicate texts to find are looked up by a hash of their folded text
+         * instead of searching the added texts, the new texts to find are sorted and added to the search tree
+         * at once.
+         *
+         * \param replacements The replacement rules, see add_replacement().
+         * \throws std::invalid_argument If a rule is invalid, see add_replacement(). The rules before the invalid
+         *         one are added.
+         * \throws std::length_error If there are more texts to find than the token ID type can identify.
+         * \throws std::logic_error If the replacer has been loaded, see load_compiled().
+         */
+        void add_replacements(const std::vector<replacement>& replacements)
+        {
+            throw_if_loaded();
+            typename token_finder_data::token_batch batch;
+            batch.search_token_finder = !finder.replacement_entries.empty();
+            // A preserve case rule of several words adds up to two entries.
+            size_t text_length = 0;
+            for (const replacement& rule : replacements)
             {
-                throw std::invalid_argument("Failed to add replacement. The text to find is null.");
+                text_length += rule.text_to_find.size() + rule.replacement_text.size();
             }
-            if (*text_to_find == 0)
+            finder.replacement_entries.owned().reserve(finder.replacement_entries.size() + 2 * replacements.size());
+            finder.texts.owned().reserve(finder.texts.size() + text_length);
+            batch.first_entry_ids.reserve(2 * replacements.size());
+            batch.tokens.reserve(2 * replacements.size());
+            try
             {
-                throw std::invalid_argument("Failed to add replacement. The text to find is empty.");
+                for (const replacement& rule : replacements)
+                {
+                    add_replacement_implementation(rule.text_to_find.c_str(), rule.replacement_text.c_str(), rule.mode, rule.match_whole_word, &batch);
+                }
             }
-            if (replacement_text == nullptr)
+            catch (...)
             {
-                throw std::invalid_argument("Failed to add replacement. The replacement text is null.");
+                finder.add_tokens(batch);
+                throw;
             }
+            finder.add_tokens(batch);
+        }
 
-            if (mode == case_mode::preserve_case)
-            {
-                std::vector<std::basic_string<char_type>> words_to_find = split_text(text_to_find);
-                if (words_to_find.empty())
-                {
-                    throw std::invalid_argument("Failed to add replacement. The text to find does not contain any valid words.");
-                }
-                std::vector<std::basic_string<char_type>> words_of_replacement = split_text(replacement_text);
-                // Add tokens for all casing variants
-                finder.add_token(to_normal_text(words_to_find), to_normal_text(words_of_replacement), match_whole_word);
-                finder.add_token(to_camel_case(words_to_find), to_camel_case(words_of_replacement), match_whole_word);
-                finder.add_token(to_pascal_case(words_to_find), to_pascal_case(words_of_replacement), match_whole_word);
-                finder.add_token(to_lowercase(words_to_find), to_lowercase(words_of_replacement), match_whole_word);
-                finder.add_token(to_uppercase(words_to_find), to_uppercase(words_of_replacement), match_whole_word);
-                finder.add_token(to_lower_snake_case(words_to_find), to_lower_snake_case(words_of_replacement), match_whole_word);
-                finder.add_token(to_upper_snake_case(words_to_find), to_upper_snake_case(words_of_replacement), match_whole_word);
-                finder.add_token(to_lower_kebab_case(words_to_find), to_lower_kebab_case(words_of_replacement), match_whole_word);
-                finder.add_token(to_upper_kebab_case(words_to_find), to_upper_kebab_case(words_of_replacement), match_whole_word);
+        /**
+         * \brief Compiles the added replacement rules for a faster search.
+         *
+         * A compiled replacer scans the text in a single pass instead of restarting the search at every
+         * text position. The search tree is turned into a contiguous state table, see compiled_size_in_bytes().
+         * The results do not change. Call this method after all replacement rules have been added, adding
+         * another rule discards the compiled state until compile() is called again.
+         */
+        void compile()
+        {
+            finder.token_finder.compile();
+        }
 
+        /**
+         * \brief Returns the memory used by the compiled state tables in bytes.
+         *
+         * \return The size of the state tables created by compile(), 0 if the replacer is not compiled.
+         */
+        size_t compiled_size_in_bytes() const
+        {
+            return finder.compiled_size_in_bytes();
+        }
+
+        /**
+         * \brief Returns the memory used by the replacer, e.g. to choose the token ID type for a large rule set.
+         *
+         * \return The memory used by the parts of the replacer in bytes, including unused capacity. The data given to
+         *         load_compiled() is not included.
+         */
+        memory_usage get_memory_usage() const
+        {
+            memory_usage usage;
+            usage.search_tree = finder.token_finder.search_tree_size_in_bytes();
+            usage.compiled = finder.compiled_size_in_bytes();
+            usage.replacements = finder.replacement_entries.capacity_in_bytes() + finder.texts.capacity_in_bytes();
+            return usage;
+        }
+
+        //! The version of the binary format written by save_compiled(), changed if the format changes.
+        static const std::uint32_t c_compiled_format_version = 1;
+
+        /**
+         * \brief Saves the compiled replacer in a binary format that can be used without deserializing it.
+         *
+         * The data contains the compiled state tables, the replacement entries with the flags of each rule and all
+         * texts in the native byte order, see load_compiled(). It starts with "robolina" followed by a header of
+         * 64 bit values: the format version, a byte order mark and the sizes of the character type, the token ID
+         * type and a replacement entry, the number of entries and the number of text characters.
+         *
+         * \param data The binary data, its previous content is replaced.
+         * \throws std::logic_error If the replacer is not compiled, see compile().
+         */
+        void save_compiled(std::vector<char>& data) const
+        {
+            if (!finder.token_finder.is_compiled())
+            {
+                throw std::logic_error("Failed to save the replacer. The replacer is not compiled.");
             }
-            else if (mode == case_mode::ignore_case)
+            data.clear();
+            const std::uint64_t header[] = { c_compiled_format_version, c_byte_order_mark, sizeof(char_type), sizeof(token_id_type),
+                sizeof(replacement_entry), finder.replacement_entries.size(), finder.texts.size() };
+            cpptokenfinder::append_binary_block(data, get_compiled_format_magic(), c_compiled_format_magic_size);
+            cpptokenfinder::append_binary_block(data, header, sizeof(header) / sizeof(header[0]));
+            const size_t entries_offset = data.size();
+            const size_t entry_count = finder.replacement_entries.size();
+            data.resize(entries_offset + ((entry_count * sizeof(replacement_entry) + 7) & ~static_cast<size_t>(7)), 0);
+            for (size_t i = 0; i < entry_count; ++i)
             {
-                i_finder.add_token(text_to_find, replacement_text, match_whole_word);
+                // Copied member by member to zeroed memory, so the same rules are always saved as the same data.
+                const replacement_entry& entry = finder.replacement_entries[i];
+                replacement_entry saved_entry;
+                std::memset(static_cast<void*>(&saved_entry), 0, sizeof(saved_entry));
+                saved_entry.text_offset = entry.text_offset;
+                saved_entry.text_length = entry.text_length;
+                saved_entry.replacement_length = entry.replacement_length;
+                saved_entry.match_whole_word = entry.match_whole_word;
+                saved_entry.ignore_case = entry.ignore_case;
+                saved_entry.preserve_case = entry.preserve_case;
+                saved_entry.has_separators = entry.has_separators;
+                saved_entry.next = entry.next;
+                std::memcpy(&data[entries_offset + i * sizeof(replacement_entry)], &saved_entry, sizeof(saved_entry));
             }
-            else if (mode == case_mode::match_case)
+            cpptokenfinder::append_binary_block(data, finder.texts.data(), finder.texts.size());
+            finder.token_finder.save_compiled(data);
+        }
+
+        /**
+         * \brief Uses a replacer saved by save_compiled() without copying its tables and texts.
+         *
+         * The replacer refers to the given data, e.g. a memory-mapped file, so large rule sets can be used right away.
+         * The data is checked, so the search cannot read outside of it. The previous replacement rules are removed.
+         *
+         * \param data The data written by save_compiled(), aligned to 8 bytes. It must not change or be freed while
+         *        the replacer refers to it, i.e. until other data is loaded or the replacer is destroyed.
+         * \param size The size of the data in bytes.
+         * \throws std::invalid_argument If the data is not a compiled replacer of this format version and type, or if
+         *         it is invalid. The replacer has no replacement rules then.
+         *
+         * A loaded replacer cannot get more replacement rules, add_replacement() and add_replacements() throw an
+         * std::logic_error exception.
+         */
+        void load_compiled(const char* data, size_t size)
+        {
+            finder = token_finder_data();
+            try
             {
-                finder.add_token(text_to_find, replacement_text, match_whole_word);
+                const char* data_end = data + size;
+                if (reinterpret_cast<std::uintptr_t>(data) % 8 != 0)
+                {
+                    throw std::invalid_argument("Failed to load the replacer. The data is not aligned to 8 bytes.");
+                }
+                const char* magic = cpptokenfinder::read_binary_block<char>(data, data_end, c_compiled_format_magic_size);
+                if (!std::equal(magic, magic + c_compiled_format_magic_size, get_compiled_format_magic()))
+                {
+                    throw std::invalid_argument("Failed to load the replacer. The data is not a compiled replacer.");
+                }
+                const std::uint64_t* header = cpptokenfinder::read_binary_block<std::uint64_t>(data, data_end, 7);
+                if (header[0] != c_compiled_format_version)
+                {
+                    throw std::invalid_argument("Failed to load the replacer. The format version is not supported.");
+                }
+                if (header[1] != c_byte_order_mark || header[2] != sizeof(char_type) || header[3] != sizeof(token_id_type) || header[4] != sizeof(replacement_entry))
+                {
+                    throw std::invalid_argument("Failed to load the replacer. It has been saved for another byte order, character type or token ID type.");
+                }
+                if (header[5] >= static_cast<std::uint64_t>(c_invalid_token_id) || header[6] > static_cast<std::uint64_t>(size))
+                {
+                    throw std::invalid_argument("Failed to load the replacer. The number of entries or texts is invalid.");
+                }
+                const size_t entry_count = static_cast<size_t>(header[5]);
+                const size_t text_count = static_cast<size_t>(header[6]);
+                const replacement_entry* p_entries = cpptokenfinder::read_binary_block<replacement_entry>(data, data_end, entry_count);
+                const char_type* p_texts = cpptokenfinder::read_binary_block<char_type>(data, data_end, text_count);
+                validate_entries(p_entries, entry_count, text_count);
+                const auto is_valid_token = [p_entries, entry_count](const token_id_type& token_id, size_t token_length)
+                {
+                    // The found text of a token is compared with the texts to find of its entries.
+                    for (size_t entry_id = token_id; entry_id < entry_count; entry_id = p_entries[entry_id].next)
+                    {
+                        if (token_length > p_entries[entry_id].text_length)
+                        {
+                            return false;
+                        }
+                    }
+                    return static_cast<size_t>(token_id) < entry_count;
+                };
+                data = finder.token_finder.load_compiled(data, data_end, is_valid_token);
+                if (data != data_end)
+                {
+                    throw std::invalid_argument("Failed to load the replacer. The data is followed by other data.");
+                }
+                finder.replacement_entries.map(p_entries, entry_count);
+                finder.texts.map(p_texts, text_count);
+                for (size_t i = 0; i < entry_count; ++i)
+                {
+                    finder.max_token_length = std::max(finder.max_token_length, p_entries[i].text_length);
+                    finder.add_whole_word_mode(p_entries[i]);
+                }
             }
-            else
+            catch (...)
             {
-                throw std::invalid_argument("Failed to add replacement. The case mode is invalid.");
+                finder = token_finder_data();
+                throw;
             }
         }
 
@@ -234,384 +530,864 @@ namespace robolina
             {
                 return;
             }
+            find_and_replace(text, text + text_size, sink);
+        }
+
+        /**
+         * \brief Performs find and replace operations on the given character range using a sink for output.
+         *
+         * The text does not need to be null-terminated, null characters are searched like any other character.
+         * This allows processing memory mapped files or a part of a larger buffer without copying it.
+         *
+         * \param text_begin Pointer to the first character of the text to process.
+         * \param text_end Pointer one past the last character of the text to process.
+         * \param sink A sink object that implements write methods to receive the processed text, see
+         *             find_and_replace(const char_type*,size_t,sink_type&)const.
+         */
+        template<typename sink_type>
+        void find_and_replace(const char_type* text_begin, const char_type* text_end, sink_type& sink) const
+        {
+            if (text_begin == nullptr || text_begin == text_end)
+            {
+                return;
+            }
 
             search_context context;
-            search_context i_context;
-            context.full_text_begin = text;
-            context.full_text_end = text + text_size;
-            context.current = text;
-            i_context.full_text_begin = text;
-            i_context.full_text_end = text + text_size;
-            i_context.current = text;
+            context.full_text_begin = text_begin;
+            context.full_text_end = text_end;
+            context.current = text_begin;
+            context.ignore_case_resume = text_begin;
+            context.match_case_resume = text_begin;
+
+            // A single search finds the tokens of all case modes.
+            while (finder.find_token(context))
+            {
+                context.write(finder, sink);
+                context.next_token();
+            }
+            if (context.current < context.full_text_end)
+            {
+                // Write the remaining text after the last token.
+                sink.write(context.current, context.full_text_end);
+            }
+        }
 
-            finder.find_token(context);
-            i_finder.find_token(i_context);
+        /**
+         * \brief Finds all texts to replace in the given character range without writing the replaced text.
+         *
+         * The edits can be used to replace the texts in place, to create a diff or to report the matches. The same
+         * texts are found as by find_and_replace(), apply_edits() writes the same result.
+         *
+         * \code{.cpp}
+         * std::vector<robolina::case_preserve_replacer<char>::edit> edits;
+         * for (const std::string& text : texts)
+         * {
+         *     // The vector is reused, so no memory is allocated once it is large enough.
+         *     replacer.find_edits(text.data(), text.data() + text.size(), edits);
+         *     for (const auto& edit : edits)
+         *     {
+         *         std::cout << edit.offset << ": " << replacer.get_replacement_text(edit.replacement_id).to_string() << std::endl;
+         *     }
+         * }
+         * \endcode
+         *
+         * \param text_begin Pointer to the first character of the text to search in.
+         * \param text_end Pointer one past the last character of the text to search in.
+         * \param edits Receives the edits ordered by their offset, the previous content is removed.
+         */
+        void find_edits(const char_type* text_begin, const char_type* text_end, std::vector<edit>& edits) const
+        {
+            edits.clear();
+            if (text_begin == nullptr || text_begin == text_end)
+            {
+                return;
+            }
+            find_chunk_edits(text_begin, text_end, search_state(), text_end, edits, nullptr);
+        }
 
-            for(;;)
+        /**
+         * \brief Finds all texts to replace like find_edits(), searching parts of a large text on several threads.
+         *
+         * The text is split into one chunk per thread. Each thread finds the texts starting in its chunk, reading
+         * beyond the chunk end by up to twice the length of the longest text to find. A text found across a chunk
+         * boundary, or a whole word text to find that is not a whole word there, can hide texts found at the begin of
+         * the next chunk. Then the calling thread searches again from there until the search reaches the state of the
+         * search of the next chunk after one of its texts. The edits are always the same as found by find_edits().
+         *
+         * \param text_begin Pointer to the first character of the text to search in.
+         * \param text_end Pointer one past the last character of the text to search in.
+         * \param edits Receives the edits ordered by their offset, the previous content is removed.
+         * \param thread_count The number of threads to use, 0 uses std::thread::hardware_concurrency() threads.
+         * \param min_chunk_size The minimum number of characters searched by a thread, smaller texts use fewer threads.
+         */
+        void find_edits_parallel(const char_type* text_begin, const char_type* text_end, std::vector<edit>& edits, size_t thread_count = 0, size_t min_chunk_size = 1024 * 1024) const
+        {
+            edits.clear();
+            if (text_begin == nullptr || text_begin == text_end)
+            {
+                return;
+            }
+            if (thread_count == 0)
+            {
+                thread_count = std::max<size_t>(1, std::thread::hardware_concurrency());
+            }
+            const size_t text_size = static_cast<size_t>(text_end - text_begin);
+            const size_t chunk_count = std::min(thread_count, std::max<size_t>(1, text_size / std::max<size_t>(1, min_chunk_size)));
+            if (chunk_count <= 1)
             {
-                bool context_has_token = context.token_found();
-                bool i_context_has_token = i_context.token_found();
+                find_chunk_edits(text_begin, text_end, search_state(), text_end, edits, nullptr);
+                return;
+            }
 
-                if (!context_has_token && !i_context_has_token)
+            std::vector<const char_type*> chunk_begins;
+            for (size_t chunk = 0; chunk < chunk_count; ++chunk)
+            {
+                chunk_begins.push_back(text_begin + text_size / chunk_count * chunk);
+            }
+            chunk_begins.push_back(text_end);
+            std::vector<chunk_search> chunk_searches(chunk_count);
+            std::vector<std::exception_ptr> errors(chunk_count);
+            auto search_chunk = [&](size_t chunk)
+            {
+                try
                 {
-                    // No more tokens found, we can stop.
-                    break;
+                    // The search of a chunk starts at the chunk begin, as if nothing was hidden there.
+                    search_state state;
+                    state.current = static_cast<size_t>(chunk_begins[chunk] - text_begin);
+                    state.ignore_case_resume = state.current;
+                    state.match_case_resume = state.current;
+                    chunk_search& result = chunk_searches[chunk];
+                    result.end_state = find_chunk_edits(text_begin, text_end, state, chunk_begins[chunk + 1], result.edits, &result.states);
                 }
-                if (context_has_token && i_context_has_token)
+                catch (...)
                 {
-                    bool overlaps = context.overlaps(i_context);
-                    // Both token finders found a token, we need to compare them.
-                    if (context.token_begin < i_context.token_begin)
-                    {
-                        // The context of the case preserving finder is before the ignore case finder.
-                        // Process the case preserving token.
-                        context.write(finder, sink);
-                        context.next_token();
-                        finder.find_token(context);
-                        i_context.advance_current_to(context.current);
-                        if (overlaps)
-                        {
-                            i_context.next_token();
-                            i_finder.find_token(i_context);
-                        }
-                    }
-                    else
-                    {
-                        // The context of the ignore case finder is before or equal to the case preserving finder.
-                        // Process the ignore case token.
-                        i_context.write(i_finder, sink);
-                        i_context.next_token();
-                        i_finder.find_token(i_context);
-                        context.advance_current_to(i_context.current);
-                        if (overlaps)
-                        {
-                            context.next_token();
-                            finder.find_token(context);
-                        }
-                    }
+                    errors[chunk] = std::current_exception();
                 }
-                else if (context_has_token)
+            };
+
+            // The calling thread searches the first chunk.
+            std::vector<std::thread> threads;
+            try
+            {
+                for (size_t chunk = 1; chunk < chunk_count; ++chunk)
                 {
-                    // Only the case preserving finder found a token.
-                    context.write(finder, sink);
-                    context.next_token();
-                    finder.find_token(context);
+                    threads.emplace_back(search_chunk, chunk);
                 }
-                else if (i_context_has_token)
+            }
+            catch (...)
+            {
+                for (auto& thread : threads)
                 {
-                    // Only the ignore case finder found a token.
-                    i_context.write(i_finder, sink);
-                    i_context.next_token();
-                    i_finder.find_token(i_context);
+                    thread.join();
                 }
+                throw;
             }
-            search_context& last_used_context = context.current < i_context.current ? i_context : context;
-            if( last_used_context.current < last_used_context.full_text_end)
+            search_chunk(0);
+            for (auto& thread : threads)
             {
-                // Write the remaining text after the last token.
-                sink.write(last_used_context.current, last_used_context.full_text_end);
+                thread.join();
+            }
+            for (const auto& error : errors)
+            {
+                if (error)
+                {
+                    std::rethrow_exception(error);
+                }
+            }
+
+            edits = std::move(chunk_searches[0].edits);
+            search_state state = chunk_searches[0].end_state;
+            for (size_t chunk = 1; chunk < chunk_count; ++chunk)
+            {
+                state = append_chunk_edits(text_begin, text_end, chunk_begins[chunk], chunk_begins[chunk + 1], chunk_searches[chunk], state, edits);
             }
         }
 
         /**
-         * \brief Convenience method to perform find and replace operations on a std::basic_string.
+         * \brief Performs find and replace operations like find_and_replace(), searching a large text on several threads.
          *
-         * This method creates a string_sink adapter and delegates to the main find_and_replace method.
+         * The texts to replace are found by find_edits_parallel(), the result is written by the calling thread.
          *
-         * \param text The text to search in.
-         * \return A new string with all replacements applied.
+         * \param text_begin Pointer to the first character of the text to process.
+         * \param text_end Pointer one past the last character of the text to process.
+         * \param sink A sink object that implements write methods to receive the processed text, see
+         *             find_and_replace(const char_type*,size_t,sink_type&)const.
+         * \param thread_count The number of threads to use, 0 uses std::thread::hardware_concurrency() threads.
+         * \param min_chunk_size The minimum number of characters searched by a thread, smaller texts use fewer threads.
          */
-        std::basic_string<char_type> find_and_replace(const std::basic_string<char_type>& text) const
+        template<typename sink_type>
+        void find_and_replace_parallel(const char_type* text_begin, const char_type* text_end, sink_type& sink, size_t thread_count = 0, size_t min_chunk_size = 1024 * 1024) const
         {
-            if (text.empty())
-            {
-                return text;
-            }
-
-            std::basic_string<char_type> result;
+            std::vector<edit> edits;
+            find_edits_parallel(text_begin, text_end, edits, thread_count, min_chunk_size);
+            apply_edits(text_begin, text_end, edits, sink);
+        }
 
-            // Define a string sink adapter that writes to our result string
-            struct string_sink
+        /**
+         * \brief Writes the text with the edits applied to a sink.
+         *
+         * \param text_begin Pointer to the first character of the text.
+         * \param text_end Pointer one past the last character of the text.
+         * \param edits The edits found by find_edits() for the same text.
+         * \param sink A sink object that implements write methods to receive the processed text, see
+         *             find_and_replace(const char_type*,size_t,sink_type&)const.
+         * \throws std::invalid_argument If the edits are not ordered or are outside of the text.
+         */
+        template<typename sink_type>
+        void apply_edits(const char_type* text_begin, const char_type* text_end, const std::vector<edit>& edits, sink_type& sink) const
+        {
+            const size_t text_size = static_cast<size_t>(text_end - text_begin);
+            size_t offset = 0;
+            for (const edit& current_edit : edits)
             {
-                std::basic_string<char_type>& result;
-
-                string_sink(std::basic_string<char_type>& target) : result(target) {}
-
-                void write(const char_type* begin, const char_type* end)
+                if (current_edit.offset < offset || current_edit.offset > text_size || current_edit.length > text_size - current_edit.offset)
                 {
-                    result.append(begin, end);
+                    throw std::invalid_argument("Failed to apply edits. The edits are not ordered or are outside of the text.");
                 }
-            };
+                sink.write(text_begin + offset, text_begin + current_edit.offset);
+                write_replacement_text(current_edit.replacement_id, sink);
+                offset = current_edit.offset + current_edit.length;
+            }
+            if (offset < text_size)
+            {
+                sink.write(text_begin + offset, text_end);
+            }
+        }
 
+        /**
+         * \brief Returns the replacement text of an edit.
+         *
+         * \param replacement_id The replacement ID of an edit found by find_edits().
+         * \return The text replacing the found text, a stored text is valid until the next replacement is added.
+         * \throws std::out_of_range If the replacement ID is invalid.
+         */
+        text_range get_replacement_text(size_t replacement_id) const
+        {
+            const replacement_entry& entry = finder.replacement_entries.at(replacement_id / c_case_form_count);
+            if (!entry.preserve_case)
+            {
+                const char_type* replacement_text = finder.get_replacement_text(entry);
+                return text_range(replacement_text, replacement_text + entry.replacement_length);
+            }
+            std::basic_string<char_type> result;
             string_sink sink(result);
-            find_and_replace(text.c_str(), text.size(), sink);
-
-            return result;
+            finder.write_replacement_text(entry, replacement_id % c_case_form_count, sink);
+            return text_range(std::move(result));
         }
 
-    protected:
-        static const size_t c_invalid_token_id = static_cast<size_t>(-1);
-
-        static char_type to_lower(char c)
+        /**
+         * \brief Writes the replacement text of an edit to a sink.
+         *
+         * The replacement text of a preserve case replacement is written in the casing of the found text, so it is
+         * not stored in the replacer.
+         *
+         * \param replacement_id The replacement ID of an edit found by find_edits().
+         * \param sink The sink to write the replacement text to, see find_and_replace(const char_type*,size_t,sink_type&)const.
+         * \throws std::out_of_range If the replacement ID is invalid.
+         */
+        template<typename sink_type>
+        void write_replacement_text(size_t replacement_id, sink_type& sink) const
         {
-            return static_cast<char_type>(std::tolower(static_cast<unsigned char>(c)));
+            const replacement_entry& entry = finder.replacement_entries.at(replacement_id / c_case_form_count);
+            finder.write_replacement_text(entry, replacement_id % c_case_form_count, sink);
         }
 
-        static char_type to_upper(char c)
+        /**
+         * \brief Finds the first text that would be replaced in the given character range.
+         *
+         * The search stops at the first match, nothing is written. Use it to skip texts without any replacement
+         * before calling find_and_replace().
+         *
+         * \param text_begin Pointer to the first character of the text to search in.
+         * \param text_end Pointer one past the last character of the text to search in.
+         * \param match_begin_out Set to the begin of the first match if there is one, otherwise unchanged.
+         * \param match_end_out Set to the end of the first match if there is one, otherwise unchanged.
+         * \return True if find_and_replace() would replace any text.
+         */
+        bool first_match(const char_type* text_begin, const char_type* text_end, const char_type*& match_begin_out, const char_type*& match_end_out) const
         {
-            return static_cast<char_type>(std::toupper(static_cast<unsigned char>(c)));
+            if (text_begin == nullptr || text_begin == text_end)
+            {
+                return false;
+            }
+            search_context context;
+            context.full_text_begin = text_begin;
+            context.full_text_end = text_end;
+            context.current = text_begin;
+            context.ignore_case_resume = text_begin;
+            context.match_case_resume = text_begin;
+            if (!finder.find_token(context))
+            {
+                return false;
+            }
+            match_begin_out = context.token_begin;
+            match_end_out = context.token_end;
+            return true;
         }
 
-        static char_type to_lower(wchar_t c)
+        /**
+         * \brief Checks if find_and_replace() would replace any text in the given character range.
+         *
+         * \param text_begin Pointer to the first character of the text to search in.
+         * \param text_end Pointer one past the last character of the text to search in.
+         * \return True if there is a text to replace.
+         */
+        bool contains_match(const char_type* text_begin, const char_type* text_end) const
         {
-            return static_cast<char_type>(std::tolower(c));
+            const char_type* match_begin = nullptr;
+            const char_type* match_end = nullptr;
+            return first_match(text_begin, text_end, match_begin, match_end);
         }
 
-        static char_type to_upper(wchar_t c)
+        /**
+         * \brief Checks if find_and_replace() would replace any text in a std::basic_string.
+         *
+         * \param text The text to search in.
+         * \return True if there is a text to replace.
+         */
+        bool contains_match(const std::basic_string<char_type>& text) const
         {
-            return static_cast<char_type>(std::toupper(c));
+            return contains_match(text.data(), text.data() + text.size());
         }
 
-        std::vector<std::basic_string<char_type>> split_text(const char_type* text) const
-        {
-            std::vector<std::basic_string<char_type>> words;
-            if (text == nullptr || *text == 0)
+        /**
+         * \brief Convenience method to perform find and replace operations on a std::basic_string.
+         *
+         * This method creates a string_sink adapter and delegates to the main find_and_replace method. The string
+         * may contain null characters.
+         *
+         * \param text The text to search in.
+         * \return A new string with all replacements applied.
+         */
+        std::basic_string<char_type> find_and_replace(const std::basic_string<char_type>& text) const
+        {
+            if (text.empty())
             {
-                return words; // Return empty vector if text is null or empty.
+                return text;
             }
 
-            std::basic_string<char_type> current_word;
-            for (const char_type* p = text; *p != 0; ++p)
-            {
-                if (*p == ' ' || *p == '-' || *p == '_') // Split by spaces, hyphens, or underscores.
-                {
-                    if (!current_word.empty())
-                    {
-                        words.push_back(current_word);
-                        current_word.clear();
-                    }
-                }
-                else
-                {
-                    // Check for transition from lowercase or digit to uppercase (camelCase boundary)
-                    if (!current_word.empty() &&
-                        (std::islower(static_cast<unsigned char>(*(p-1))) || std::isdigit(static_cast<unsigned char>(*(p-1))))&&
-                        std::isupper(static_cast<unsigned char>(*p)))
-                    {
-                        words.push_back(current_word);
-                        current_word.clear();
-                    }
-                    current_word += *p;
-                }
-            }
-            if (!current_word.empty())
-            {
-                words.push_back(current_word);
-            }
-            return words;
+            std::basic_string<char_type> result;
+            string_sink sink(result);
+            find_and_replace(text.data(), text.data() + text.size(), sink);
+
+            return result;
         }
 
-        std::basic_string<char_type> to_normal_text(const std::vector<std::basic_string<char_type>>& words) const
+#if defined(ROBOLINA_HAS_STRING_VIEW)
+        /**
+         * \brief Performs find and replace operations on a std::basic_string_view using a sink for output.
+         *
+         * \param text The text to search in, it does not need to be null-terminated.
+         * \param sink A sink object that implements write methods to receive the processed text, see
+         *             find_and_replace(const char_type*,size_t,sink_type&)const.
+         */
+        template<typename sink_type>
+        void find_and_replace(std::basic_string_view<char_type> text, sink_type& sink) const
+        {
+            find_and_replace(text.data(), text.data() + text.size(), sink);
+        }
+
+        /**
+         * \brief Convenience method to perform find and replace operations on a std::basic_string_view.
+         *
+         * \param text The text to search in, it does not need to be null-terminated.
+         * \return A new string with all replacements applied.
+         */
+        std::basic_string<char_type> find_and_replace(std::basic_string_view<char_type> text) const
         {
             std::basic_string<char_type> result;
-            for (const auto& word : words)
+            string_sink sink(result);
+            find_and_replace(text.data(), text.data() + text.size(), sink);
+            return result;
+        }
+
+        /**
+         * \brief Convenience method to perform find and replace operations on a null-terminated text.
+         *
+         * \param text The null-terminated text to search in.
+         * \return A new string with all replacements applied.
+         */
+        std::basic_string<char_type> find_and_replace(const char_type* text) const
+        {
+            if (text == nullptr)
             {
-                if (!result.empty())
-                {
-                    result += ' '; // Add space between words.
-                }
-                result += word;
+                return std::basic_string<char_type>();
             }
-            return result;
+            return find_and_replace(std::basic_string_view<char_type>(text));
         }
+#endif
 
-        std::basic_string<char_type> to_camel_case(const std::vector<std::basic_string<char_type>>& words) const
+        /**
+         * \brief Replaces the texts in a text written in chunks of any size, e.g. read from a file or a pipe.
+         *
+         * The processed text is written to the sink like by find_and_replace(). Only the text that can still be part
+         * of a text to find is kept, so the memory used does not depend on the size of the whole text. Small chunks
+         * are collected until a block of text is available, so writing single characters is still fast. A
+         * stream_replacer is itself a sink and can be used by another replacer.
+         *
+         * \code{.cpp}
+         * robolina::case_preserve_replacer<char>::stream_replacer<my_sink> stream(replacer, sink);
+         * while (size_t size = read_chunk(buffer, sizeof(buffer)))
+         * {
+         *     stream.write(buffer, buffer + size);
+         * }
+         * stream.finish();
+         * \endcode
+         *
+         * The replacer must not be changed while it is used by a stream_replacer.
+         *
+         * \tparam sink_type A sink type, see find_and_replace(const char_type*,size_t,sink_type&)const.
+         */
+        template<typename sink_type>
+        class stream_replacer
         {
-            std::basic_string<char_type> result;
-            bool first_word = true;
-            for (const auto& word : words)
+        public:
+            /**
+             * \brief Creates a stream_replacer writing to a sink.
+             *
+             * \param rules The replacer with the replacement rules.
+             * \param target The sink receiving the processed text.
+             * \param search_block_size The number of characters collected before they are searched.
+             */
+            stream_replacer(const case_preserve_replacer& rules, sink_type& target, size_t search_block_size = 64 * 1024)
+                : replacer(rules)
+                , sink(target)
+                , block_size(std::max<size_t>(1, search_block_size))
+            {
+            }
+
+            /**
+             * \brief Writes the next chunk of the text.
+             *
+             * \param begin Pointer to the first character of the chunk.
+             * \param end Pointer one past the last character of the chunk.
+             */
+            void write(const char_type* begin, const char_type* end)
             {
-                if (word.empty())
+                const size_t limit = block_size + 2 * replacer.finder.max_token_length;
+                while (begin != end)
                 {
-                    continue;
+                    // Large chunks are processed in blocks, so the kept text does not grow beyond the limit.
+                    const size_t count = std::min(static_cast<size_t>(end - begin), limit - (pending.size() - current));
+                    pending.append(begin, begin + count);
+                    begin += count;
+                    if (pending.size() - current >= limit)
+                    {
+                        process(false);
+                    }
                 }
+            }
 
-                if (first_word)
+            /**
+             * \brief Writes the kept text at the end of the text to the sink.
+             *
+             * Call this method after the last chunk of the text. The stream_replacer can then be used for another text.
+             */
+            void finish()
+            {
+                process(true);
+                pending.clear();
+                current = 0;
+                ignore_case_resume = 0;
+                match_case_resume = 0;
+            }
+
+        private:
+            // Writes the text up to the position where a text to find may continue in the next chunk.
+            void process(bool is_final)
+            {
+                // The search also checks the texts starting within a text found before safe_end, so these need to
+                // be complete too.
+                const size_t lookahead = 2 * replacer.finder.max_token_length;
+                search_context context;
+                context.full_text_begin = pending.data();
+                context.full_text_end = pending.data() + pending.size();
+                context.current = pending.data() + current;
+                context.ignore_case_resume = pending.data() + std::max(current, ignore_case_resume);
+                context.match_case_resume = pending.data() + std::max(current, match_case_resume);
+
+                // A text found before safe_end ends before the end of the kept text. So it is not changed by the
+                // following text and the character after it is known for the whole word check.
+                const char_type* safe_end = context.full_text_end;
+                if (!is_final)
                 {
-                    // First word starts with lowercase
-                    result +=to_lower(word[0]);
-                    first_word = false;
+                    safe_end = pending.size() - current > lookahead ? context.full_text_end - lookahead : context.current;
                 }
-                else
+                while (replacer.finder.find_token(context, context.full_text_end, safe_end))
+                {
+                    context.write(replacer.finder, sink);
+                    context.next_token();
+                }
+                if (context.current < safe_end)
                 {
-                    // Subsequent words start with uppercase
-                    result += to_upper(word[0]);
+                    sink.write(context.current, safe_end);
+                    context.current = safe_end;
                 }
 
-                // Rest of the word in lowercase
-                for (size_t i = 1; i < word.size(); ++i)
+                // Keep the last written character for the whole word check.
+                const size_t written = static_cast<size_t>(context.current - pending.data());
+                ignore_case_resume = static_cast<size_t>(std::max(context.current, context.ignore_case_resume) - pending.data());
+                match_case_resume = static_cast<size_t>(std::max(context.current, context.match_case_resume) - pending.data());
+                if (written > 0)
                 {
-                    result +=to_lower(word[i]);
+                    pending.erase(0, written - 1);
+                    current = 1;
+                    ignore_case_resume -= written - 1;
+                    match_case_resume -= written - 1;
                 }
             }
-            return result;
-        }
 
-        std::basic_string<char_type> to_pascal_case(const std::vector<std::basic_string<char_type>>& words) const
+            const case_preserve_replacer& replacer;
+            sink_type& sink;
+            size_t block_size;
+            std::basic_string<char_type> pending; //!< The text not written yet, after the last written character if any.
+            size_t current = 0; //!< The position of the text not written yet in pending, 0 at the text begin, otherwise 1.
+            size_t ignore_case_resume = 0; //!< The ignore case tokens starting before this position in pending are skipped.
+            size_t match_case_resume = 0; //!< The tokens matching the case starting before this position in pending are skipped.
+        };
+
+    protected:
+        static const token_id_type c_invalid_token_id = static_cast<token_id_type>(-1);
+
+        // The state of a search after a found text or at a chunk end, as offsets in the text. The resume positions are
+        // at least the current position, so equal states continue with the same search.
+        struct search_state
         {
-            std::basic_string<char_type> result;
-            for (const auto& word : words)
+            size_t current = 0; //!< The position to continue the search.
+            size_t ignore_case_resume = 0; //!< Ignore case tokens starting before this position are skipped.
+            size_t match_case_resume = 0; //!< Tokens matching the case starting before this position are skipped.
+
+            bool operator==(const search_state& other) const
             {
-                if (word.empty())
-                {
-                    continue;
-                }
+                return current == other.current && ignore_case_resume == other.ignore_case_resume && match_case_resume == other.match_case_resume;
+            }
+        };
 
-                // Every word starts with uppercase
-                result += to_upper(word[0]);
+        // The edits found by find_chunk_edits() for a chunk of a text searched on several threads.
+        struct chunk_search
+        {
+            std::vector<edit> edits;
+            std::vector<search_state> states; //!< The state after each edit.
+            search_state end_state; //!< The state at the chunk end.
+        };
 
-                // Rest of the word in lowercase
-                for (size_t i = 1; i < word.size(); ++i)
+        // Appends the edits of the texts starting before the chunk end, searching from the given state. The texts
+        // found may end after the chunk end. If states is not null, the state after each edit is appended to it.
+        // Returns the state at the chunk end.
+        search_state find_chunk_edits(const char_type* text_begin, const char_type* text_end, const search_state& state, const char_type* chunk_end, std::vector<edit>& edits, std::vector<search_state>* states) const
+        {
+            search_context context;
+            context.full_text_begin = text_begin;
+            context.full_text_end = text_end;
+            context.set_state(state);
+            const char_type* search_end = get_search_end(text_end, chunk_end);
+            while (finder.find_token(context, search_end, chunk_end))
+            {
+                edit found_edit;
+                found_edit.offset = static_cast<size_t>(context.token_begin - text_begin);
+                found_edit.length = static_cast<size_t>(context.token_end - context.token_begin);
+                found_edit.replacement_id = context.get_replacement_id();
+                edits.push_back(found_edit);
+                context.next_token();
+                if (states != nullptr)
                 {
-                    result +=to_lower(word[i]);
+                    states->push_back(context.get_state());
                 }
             }
-            return result;
+            return context.get_state();
         }
 
-        std::basic_string<char_type> to_lowercase(const std::vector<std::basic_string<char_type>>& words) const
+        // Appends the edits found by find_chunk_edits() for a chunk to the edits of the text before it, given the
+        // state of the search at the chunk begin. A text found across the chunk boundary or a text that is not a whole
+        // word can hide texts found at the begin of the chunk. Then the search continues from this state until it
+        // reaches the state of the chunk search after one of its edits, the following edits are the same. Returns
+        // the state at the chunk end.
+        search_state append_chunk_edits(const char_type* text_begin, const char_type* text_end, const char_type* chunk_begin, const char_type* chunk_end, const chunk_search& chunk, const search_state& state, std::vector<edit>& edits) const
         {
-            std::basic_string<char_type> result;
-            for (const auto& word : words)
+            const size_t chunk_begin_offset = static_cast<size_t>(chunk_begin - text_begin);
+            if (state.ignore_case_resume <= chunk_begin_offset && state.match_case_resume <= chunk_begin_offset)
             {
-                for (const auto& c : word)
+                // Nothing is hidden at the chunk begin, so the search is in the same state as the chunk search.
+                edits.insert(edits.end(), chunk.edits.begin(), chunk.edits.end());
+                return chunk.end_state;
+            }
+            search_context context;
+            context.full_text_begin = text_begin;
+            context.full_text_end = text_end;
+            context.set_state(state);
+            const char_type* search_end = get_search_end(text_end, chunk_end);
+            size_t next = 0;
+            while (finder.find_token(context, search_end, chunk_end))
+            {
+                edit found_edit;
+                found_edit.offset = static_cast<size_t>(context.token_begin - text_begin);
+                found_edit.length = static_cast<size_t>(context.token_end - context.token_begin);
+                found_edit.replacement_id = context.get_replacement_id();
+                edits.push_back(found_edit);
+                context.next_token();
+
+                const search_state current_state = context.get_state();
+                while (next < chunk.edits.size() && chunk.states[next].current < current_state.current)
+                {
+                    ++next;
+                }
+                if (next < chunk.edits.size() && chunk.states[next] == current_state)
                 {
-                    result +=to_lower(c);
+                    edits.insert(edits.end(), chunk.edits.begin() + static_cast<std::ptrdiff_t>(next + 1), chunk.edits.end());
+                    return chunk.end_state;
                 }
             }
-            return result;
+            return context.get_state();
         }
 
-        std::basic_string<char_type> to_uppercase(const std::vector<std::basic_string<char_type>>& words) const
+        // Returns the end of the text that is needed to find all texts starting before the chunk end.
+        const char_type* get_search_end(const char_type* text_end, const char_type* chunk_end) const
         {
-            std::basic_string<char_type> result;
-            for (const auto& word : words)
-            {
-                for (const auto& c : word)
-                {
-                    result += to_upper(c);
-                }
-            }
-            return result;
+            // The texts starting within a text found before the chunk end are checked too, see token_finder_data::find_token().
+            const size_t lookahead = 2 * finder.max_token_length;
+            return static_cast<size_t>(text_end - chunk_end) > lookahead ? chunk_end + lookahead : text_end;
         }
 
-        std::basic_string<char_type> to_snake_case(const std::vector<std::basic_string<char_type>>& words, bool uppercase = false) const
+        // A sink adapter that appends to a string.
+        struct string_sink
         {
-            std::basic_string<char_type> result;
-            bool first_word = true;
-            for (const auto& word : words)
+            std::basic_string<char_type>& result;
+
+            string_sink(std::basic_string<char_type>& target) : result(target) {}
+
+            void write(const char_type* begin, const char_type* end)
             {
-                if (word.empty())
-                {
-                    continue;
-                }
+                result.append(begin, end);
+            }
+        };
 
-                if (!first_word)
-                {
-                    result += '_';
-                }
-                first_word = false;
+        std::vector<std::basic_string<char_type>> split_text(const char_type* text) const
+        {
+            std::vector<std::basic_string<char_type>> words;
+            if (text == nullptr || *text == 0)
+            {
+                return words; // Return empty vector if text is null or empty.
+            }
 
-                for (const auto& c : word)
+            std::basic_string<char_type> current_word;
+            for (const char_type* p = text; *p != 0; ++p)
+            {
+                if (ascii_ctype::is_separator(*p)) // Split by spaces, hyphens, or underscores.
                 {
-                    if (uppercase)
+                    if (!current_word.empty())
                     {
-                        result += to_upper(c);
+                        words.push_back(current_word);
+                        current_word.clear();
                     }
-                    else
+                }
+                else
+                {
+                    // Check for transition from lowercase or digit to uppercase (camelCase boundary)
+                    if (!current_word.empty() &&
+                        ascii_ctype::is(*(p-1), ascii_ctype::lower | ascii_ctype::digit) &&
+                        ascii_ctype::is(*p, ascii_ctype::upper))
                     {
-                        result +=to_lower(c);
+                        words.push_back(current_word);
+                        current_word.clear();
                     }
+                    current_word += *p;
                 }
             }
-            return result;
-        }
-
-        std::basic_string<char_type> to_lower_snake_case(const std::vector<std::basic_string<char_type>>& words) const
-        {
-            return to_snake_case(words, false);
-        }
-
-        std::basic_string<char_type> to_upper_snake_case(const std::vector<std::basic_string<char_type>>& words) const
-        {
-            return to_snake_case(words, true);
+            if (!current_word.empty())
+            {
+                words.push_back(current_word);
+            }
+            return words;
         }
 
-        std::basic_string<char_type> to_kebab_case(const std::vector<std::basic_string<char_type>>& words, bool uppercase = false) const
+        std::basic_string<char_type> to_normal_text(const std::vector<std::basic_string<char_type>>& words) const
         {
             std::basic_string<char_type> result;
-            bool first_word = true;
             for (const auto& word : words)
             {
-                if (word.empty())
-                {
-                    continue;
-                }
-
-                if (!first_word)
-                {
-                    result += '-';
-                }
-                first_word = false;
-
-                for (const auto& c : word)
+                if (!result.empty())
                 {
-                    if (uppercase)
-                    {
-                        result += to_upper(c);
-                    }
-                    else
-                    {
-                        result +=to_lower(c);
-                    }
+                    result += ' '; // Add space between words.
                 }
+                result += word;
             }
             return result;
         }
 
-        std::basic_string<char_type> to_lower_kebab_case(const std::vector<std::basic_string<char_type>>& words) const
+        static const size_t c_case_form_count = 20;
+        static const size_t c_common_case_form_count = 9; //!< Preferred if a found text has several case forms.
+
+        enum class word_case
         {
-            return to_kebab_case(words, false);
-        }
+            original, //!< The words of the text to find or the replacement text.
+            camel, //!< The first word in lowercase, the other ones capitalized.
+            pascal, //!< All words capitalized.
+            lower,
+            upper
+        };
+
+        // The casing of a text in preserve case mode. A text to find is stored as its words separated by spaces. Its
+        // case forms are searched in order, the first one matching the found text is used to write the replacement
+        // words. So a text found in several case forms, e.g. a single lowercase word, is replaced in the first one.
+        struct case_form
+        {
+            char_type separator; //!< The character between the words, 0 if they are not separated.
+            word_case words;
+
+            char_type get_character(char_type value, size_t word_index, size_t character_index) const
+            {
+                switch (words)
+                {
+                case word_case::camel:
+                    return character_index == 0 && word_index != 0 ? ascii_ctype::to_upper(value) : ascii_ctype::to_lower(value);
+                case word_case::pascal:
+                    return character_index == 0 ? ascii_ctype::to_upper(value) : ascii_ctype::to_lower(value);
+                case word_case::lower:
+                    return ascii_ctype::to_lower(value);
+                case word_case::upper:
+                    return ascii_ctype::to_upper(value);
+                default:
+                    return value;
+                }
+            }
+        };
 
-        std::basic_string<char_type> to_upper_kebab_case(const std::vector<std::basic_string<char_type>>& words) const
+        static const case_form& get_case_form(size_t index)
         {
-            return to_kebab_case(words, true);
+            // The common forms first: normal text, camelCase, PascalCase, lowercase, UPPERCASE, snake_case,
+            // UPPER_SNAKE_CASE, kebab-case and UPPER-KEBAB-CASE.
+            static const case_form forms[c_case_form_count] =
+            {
+                { ' ', word_case::original }, { 0, word_case::camel }, { 0, word_case::pascal }, { 0, word_case::lower },
+                { 0, word_case::upper }, { '_', word_case::lower }, { '_', word_case::upper }, { '-', word_case::lower },
+                { '-', word_case::upper }, { 0, word_case::original }, { '_', word_case::original }, { '-', word_case::original },
+                { ' ', word_case::lower }, { ' ', word_case::upper }, { ' ', word_case::pascal }, { '_', word_case::pascal },
+                { '-', word_case::pascal }, { ' ', word_case::camel }, { '_', word_case::camel }, { '-', word_case::camel }
+            };
+            return forms[index];
         }
 
+        // The texts of an entry are stored in the texts of the token_finder_data, the text to find is followed by the
+        // replacement text.
         struct replacement_entry
         {
             replacement_entry() = default;
-            replacement_entry(std::basic_string<char_type>&& text, bool match_whole_word)
-                : replacement_text(std::move(text))
+            replacement_entry(size_t offset, size_t length_to_find, size_t length_of_replacement, bool match_whole_word, case_mode mode)
+                : text_offset(offset)
+                , text_length(length_to_find)
+                , replacement_length(length_of_replacement)
                 , match_whole_word(match_whole_word)
+                , ignore_case(mode == case_mode::ignore_case)
+                , preserve_case(mode == case_mode::preserve_case)
             {
             }
 
-            std::basic_string<char_type> replacement_text;
+            size_t text_offset = 0; //!< The position of the text to find in the texts.
+            size_t text_length = 0; //!< The length of the text to find, its words separated by spaces in preserve case mode.
+            size_t replacement_length = 0; //!< The length of the replacement text.
             bool match_whole_word = false; //!< If true, the text to find must be a whole word.
+            bool ignore_case = false; //!< If true, the text to find can have any casing.
+            bool preserve_case = false; //!< If true, the text to find can have any of the case forms.
+            bool has_separators = false; //!< If true, the text to find contains separators, which are equal to each other for the token finder.
+            token_id_type next = c_invalid_token_id; //!< The next entry with the same text to find ignoring the case or c_invalid_token_id.
+        };
+
+        // Classifies the characters like std::isalnum, std::isdigit, std::islower, std::isupper and std::tolower in the
+        // "C" locale. The table lookup is inlined, the library functions are called for each character and may
+        // consult the locale.
+        struct ascii_ctype
+        {
+            enum : unsigned char
+            {
+                lower = 0x01,
+                digit = 0x02,
+                separator = 0x04, //!< Separates the words of a text in preserve case mode.
+                upper = 0x20 //!< The difference between an uppercase letter and its lowercase letter.
+            };
+
+            static constexpr unsigned char flags[256] =
+            {
+                0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x00
+                0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x10
+                separator, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, separator, 0, 0, // 0x20
+                digit, digit, digit, digit, digit, digit, digit, digit, digit, digit, 0, 0, 0, 0, 0, 0, // 0x30
+                0, upper, upper, upper, upper, upper, upper, upper, upper, upper, upper, upper, upper, upper, upper, upper, // 0x40
+                upper, upper, upper, upper, upper, upper, upper, upper, upper, upper, upper, 0, 0, 0, 0, separator, // 0x50
+                0, lower, lower, lower, lower, lower, lower, lower, lower, lower, lower, lower, lower, lower, lower, lower, // 0x60
+                lower, lower, lower, lower, lower, lower, lower, lower, lower, lower, lower, 0, 0, 0, 0, 0, // 0x70
+                0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x80
+                0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x90
+                0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xA0
+                0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xB0
+                0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xC0
+                0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xD0
+                0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xE0
+                0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 // 0xF0
+            };
+
+            // Like calling the library functions with static_cast<unsigned char>(value), the low byte of a wide
+            // character is classified.
+            static bool is(char_type value, unsigned int mask)
+            {
+                return (flags[static_cast<unsigned char>(value)] & mask) != 0;
+            }
+
+            static bool is_alnum(char_type value)
+            {
+                return is(value, lower | upper | digit);
+            }
+
+            // Characters above 255 are not changed.
+            static char_type to_lower(char_type value)
+            {
+                typedef typename std::make_unsigned<char_type>::type unsigned_char_type;
+                const size_t unsigned_value = static_cast<size_t>(static_cast<unsigned_char_type>(value));
+                return unsigned_value < 256 ? static_cast<char_type>(unsigned_value + (flags[unsigned_value] & upper)) : value;
+            }
+
+            // Characters above 255 are not changed.
+            static char_type to_upper(char_type value)
+            {
+                typedef typename std::make_unsigned<char_type>::type unsigned_char_type;
+                const size_t unsigned_value = static_cast<size_t>(static_cast<unsigned_char_type>(value));
+                return unsigned_value < 256 && (flags[unsigned_value] & lower) != 0 ? static_cast<char_type>(unsigned_value - upper) : value;
+            }
+
+            // Spaces, hyphens and underscores.
+            static bool is_separator(char_type value)
+            {
+                return value == ' ' || value == '-' || value == '_';
+            }
+
+            // Returns the lowercase character of a letter and an underscore for a separator. Characters above 255
+            // are not changed.
+            static char_type fold(char_type value)
+            {
+                typedef typename std::make_unsigned<char_type>::type unsigned_char_type;
+                const size_t unsigned_value = static_cast<size_t>(static_cast<unsigned_char_type>(value));
+                if (unsigned_value >= 256)
+                {
+                    return value;
+                }
+                const unsigned char value_flags = flags[unsigned_value];
+                return static_cast<char_type>((value_flags & separator) != 0 ? '_' : unsigned_value + (value_flags & upper));
+            }
         };
 
+        // Compares the lowercase characters, the separators are equal to each other. The token finder stores the
+        // folded, i.e. lowercase, token characters and folds each searched character using the ascii_ctype table.
+        // A found text is checked by the entries of its token, see token_finder_data::token_filter.
         class token_finder_ignore_case_comparer
         {
         public:
-            template <typename char_type_a, typename char_type_b>
-            bool operator()(char_type_a value_lhs, char_type_b value_rhs) const
+            bool operator()(char_type value_lhs, char_type value_rhs) const
+            {
+                return fold(value_lhs) == fold(value_rhs);
+            }
+
+            char_type fold(char_type value) const
             {
-                auto value_lhs_low = std::tolower(value_lhs);
-                auto value_rhs_low = std::tolower(value_rhs);
-                bool result = (value_lhs_low == value_rhs_low);
-                return result;
+                return ascii_ctype::fold(value);
             }
         };
 
@@ -622,7 +1398,10 @@ namespace robolina
             const char_type* current = nullptr; //!< The text to search in. Current position in the text.
             const char_type* token_begin = nullptr; //!< The begin of a token or nullptr if no token is found.
             const char_type* token_end = nullptr; //!< The end of a token or nullptr if no token is found.
-            size_t token_id = c_invalid_token_id; //!< The ID of the found token or c_invalid_token_id if no token is found.
+            token_id_type token_id = c_invalid_token_id; //!< The ID of the found token or c_invalid_token_id if no token is found.
+            size_t case_form = 0; //!< The index of the case form of the found text in preserve case mode, see get_case_form().
+            const char_type* ignore_case_resume = nullptr; //!< Ignore case tokens starting before this position are skipped.
+            const char_type* match_case_resume = nullptr; //!< Tokens matching the case starting before this position are skipped.
 
             template<typename finder_type, typename sink_type>
             void write(const finder_type& finder, sink_type& sink) const
@@ -633,20 +1412,13 @@ namespace robolina
                 if (token_id != c_invalid_token_id)
                 {
                     // If we have a valid token ID, we can use it to get the replacement text.
-                    const auto& replacement = finder.replacement_entries[token_id];
-                    sink.write(replacement.replacement_text.data(), replacement.replacement_text.data() + replacement.replacement_text.size());
+                    finder.write_replacement_text(finder.replacement_entries[token_id], case_form, sink);
                 }
             }
 
-            void advance_current_to(const char_type* new_current)
+            size_t get_replacement_id() const
             {
-                current = new_current;
-                if (token_begin && token_begin < new_current) // new_current is after the token begin -> drop the token
-                {
-                    token_begin = nullptr;
-                    token_end = nullptr;
-                    token_id = c_invalid_token_id;
-                }
+                return static_cast<size_t>(token_id) * c_case_form_count + case_form;
             }
 
             void next_token()
@@ -657,41 +1429,33 @@ namespace robolina
                 }
             }
 
-            bool overlaps(const search_context& other) const
-            {
-                return (token_begin < other.token_end && other.token_begin < token_end) ||
-                       (token_begin == other.token_begin); // Check for overlapping or same starting position
-
-                // Examples with positions 0-9:
-                // Case 1: Regular overlap
-                // Token A: [2,5) - token_begin=2, token_end=5
-                // Token B: [4,7) - token_begin=4, token_end=7
-                // Result: true (A.begin=2 < B.end=7 && B.begin=4 < A.end=5)
-                //
-                // Case 2: One token completely inside another
-                // Token A: [1,8) - token_begin=1, token_end=8
-                // Token B: [3,6) - token_begin=3, token_end=6
-                // Result: true (A.begin=1 < B.end=6 && B.begin=3 < A.end=8)
-                //
-                // Case 3: Same starting position
-                // Token A: [2,5) - token_begin=2, token_end=5
-                // Token B: [2,7) - token_begin=2, token_end=7
-                // Result: true (A.begin==B.begin)
-                //
-                // Case 4: Same ending position
-                // Token A: [2,6) - token_begin=2, token_end=6
-                // Token B: [4,6) - token_begin=4, token_end=6
-                // Result: true (A.begin=2 < B.end=6 && B.begin=4 < A.end=6)
-                //
-                // Case 5: Adjacent tokens (not overlapping)
-                // Token A: [1,3) - token_begin=1, token_end=3
-                // Token B: [3,5) - token_begin=3, token_end=5
-                // Result: false (!(A.begin=1 < B.end=5 && B.begin=3 < A.end=3))
-                //
-                // Case 6: No overlap
-                // Token A: [1,3) - token_begin=1, token_end=3
-                // Token B: [5,8) - token_begin=5, token_end=8
-                // Result: false (!(A.begin=1 < B.end=8 && B.begin=5 < A.end=3))
+            search_state get_state() const
+            {
+                search_state state;
+                state.current = static_cast<size_t>(current - full_text_begin);
+                state.ignore_case_resume = static_cast<size_t>(std::max(current, ignore_case_resume) - full_text_begin);
+                state.match_case_resume = static_cast<size_t>(std::max(current, match_case_resume) - full_text_begin);
+                return state;
+            }
+
+            void set_state(const search_state& state)
+            {
+                current = full_text_begin + state.current;
+                ignore_case_resume = full_text_begin + state.ignore_case_resume;
+                match_case_resume = full_text_begin + state.match_case_resume;
+            }
+
+            bool is_whole_word(const char_type* token_begin, const char_type* token_end) const
+            {
+                if (token_begin > full_text_begin && ascii_ctype::is_alnum(*(token_begin - 1)))
+                {
+                    return false; // Not a whole word, previous character is alphanumeric.
+                }
+                if (token_end < full_text_end && ascii_ctype::is_alnum(*token_end))
+                {
+                    return false; // Not a whole word, next character is alphanumeric.
+                }
+                return true;
             }
 
             bool token_found() const
@@ -700,83 +1464,595 @@ namespace robolina
             }
         };
 
-        template<typename comparer_type>
+        // Holds the tokens of all case modes in a single token finder ignoring the case. The token ID is the index
+        // of the first replacement entry with this text to find ignoring the case, the entries are chained by next.
         struct token_finder_data
         {
-            typedef cpptokenfinder::token_finder<char_type, token_id_type, token_id_type, c_invalid_token_id, comparer_type> token_finder_t;
+            typedef cpptokenfinder::token_finder<char_type, token_id_type, token_id_type, c_invalid_token_id, token_finder_ignore_case_comparer> token_finder_t;
             token_finder_t token_finder;
-            std::vector<replacement_entry> replacement_entries;
+            cpptokenfinder::mappable_vector<replacement_entry> replacement_entries; //!< Refers to the loaded data if loaded, see load_compiled().
+            cpptokenfinder::mappable_vector<char_type> texts; //!< The texts of all replacement entries, written from adjacent memory.
+            size_t max_token_length = 0; //!< The length of the longest text to find.
+            bool has_ignore_case_whole_words = false; //!< If true, an ignore case entry needs a whole word.
+            bool has_match_case_whole_words = false; //!< If true, an entry matching the case needs a whole word.
+
+            // The longest token of a case mode found at a text position.
+            struct candidate
+            {
+                const char_type* token_end = nullptr; //!< The end of the token or nullptr if there is none.
+                token_id_type entry_id = c_invalid_token_id; //!< The replacement entry of the token.
+                size_t case_form = 0; //!< The case form of the found text in preserve case mode.
+                bool is_accepted = false; //!< False if the entry needs a whole word and the token is not one.
+            };
 
-            bool find_token(search_context& context) const
+            // The tokens of both case modes found at a text position.
+            struct candidates
+            {
+                const char_type* token_begin = nullptr; //!< The text position or nullptr if no token was found yet.
+                candidate ignore_case; //!< The longest ignore case token.
+                candidate match_case; //!< The longest token matching the case, also in preserve case mode.
+            };
+
+            // Collects the longest token of each case mode found at a text position, like each case mode had its own
+            // search. The tokens of a position are found by increasing length. A token which is not a whole word still
+            // hides the shorter tokens of its case mode. Once the search moves on, the case mode skips the tokens
+            // starting before its end. So a position is only ranked if it has an accepted token.
+            class token_filter
             {
-                bool result = true;
-                const char_type* preserve_current = context.current;
-                while(result)
+            public:
+                token_filter(const token_finder_data& finder_data, search_context& search, candidates& found_candidates, const char_type* begin_end,
+                    bool accept_ignore_case = true, bool accept_match_case = true)
+                    : data(finder_data)
+                    , context(search)
+                    , found(found_candidates)
+                    , search_begin_end(begin_end)
+                    , ignore_case(accept_ignore_case)
+                    , match_case(accept_match_case)
+                {
+                }
+
+                size_t operator()(token_id_type token_id, const char_type* token_begin, const char_type* token_end) const
                 {
-                    result = token_finder.find_token(context.current, context.token_begin, context.token_end, context.token_id);
-                    if (result)
+                    if (token_begin >= search_begin_end)
+                    {
+                        return 0;
+                    }
+                    if (token_begin != found.token_begin)
                     {
-                        // Check if the token matches the whole word condition.
-                        const auto& replacement = replacement_entries[context.token_id];
-                        if (replacement.match_whole_word)
+                        skip_rejected_tokens();
+                        found = candidates();
+                        found.token_begin = token_begin;
+                    }
+                    // Most tokens have a single entry, so there is only its case mode to check.
+                    const auto& first_entry = data.replacement_entries[token_id];
+                    const bool is_single_entry = first_entry.next == c_invalid_token_id;
+                    if (ignore_case && token_begin >= context.ignore_case_resume && (!is_single_entry || first_entry.ignore_case))
+                    {
+                        const token_id_type entry_id = data.find_ignore_case_entry(token_id, token_begin, token_end);
+                        if (entry_id != c_invalid_token_id)
                         {
-                            // Check if the token is a whole word.
-                            bool is_whole_word = true;
-                            if (context.token_begin > context.full_text_begin &&
-                                std::isalnum(static_cast<unsigned char>(*(context.token_begin - 1))))
-                            {
-                                is_whole_word = false; // Not a whole word, previous character is alphanumeric.
-                            }
-                            if (is_whole_word && context.token_end < context.full_text_end &&
-                                std::isalnum(static_cast<unsigned char>(*context.token_end)))
-                            {
-                                is_whole_word = false; // Not a whole word, next character is alphanumeric.
-                            }
-                            if (is_whole_word)
-                            {
-                                break; // Found a valid token that matches the whole word condition.
-                            }
-                            else
-                            {
-                                context.next_token(); // Move to the next position in the text.
-                            }
+                            set_candidate(found.ignore_case, entry_id, 0, token_begin, token_end);
                         }
-                        else
+                    }
+                    if (match_case && token_begin >= context.match_case_resume && (!is_single_entry || !first_entry.ignore_case))
+                    {
+                        size_t case_form = 0;
+                        const token_id_type entry_id = data.find_match_case_entry(token_id, token_begin, token_end, case_form);
+                        if (entry_id != c_invalid_token_id)
                         {
-                            break; // Found a valid token that does not require whole word matching.
+                            set_candidate(found.match_case, entry_id, case_form, token_begin, token_end);
                         }
                     }
+                    return found.ignore_case.is_accepted || found.match_case.is_accepted ? 1 : 0;
                 }
-                context.current = preserve_current; // Restore the current position in the text.
-                if (!result)
+
+                // The tokens of the position which are not whole words hide the tokens of their case mode starting before their end.
+                void skip_rejected_tokens() const
                 {
-                    context.token_begin = nullptr; // No token found.
-                    context.token_end = nullptr; // No token found.
-                    context.token_id = c_invalid_token_id; // No token found.
+                    if (found.ignore_case.token_end != nullptr && !found.ignore_case.is_accepted)
+                    {
+                        context.ignore_case_resume = found.ignore_case.token_end;
+                    }
+                    if (found.match_case.token_end != nullptr && !found.match_case.is_accepted)
+                    {
+                        context.match_case_resume = found.match_case.token_end;
+                    }
+                }
+
+            private:
+                void set_candidate(candidate& longest, token_id_type entry_id, size_t case_form, const char_type* token_begin, const char_type* token_end) const
+                {
+                    longest.token_end = token_end;
+                    longest.entry_id = entry_id;
+                    longest.case_form = case_form;
+                    longest.is_accepted = !data.replacement_entries[entry_id].match_whole_word || context.is_whole_word(token_begin, token_end);
                 }
-                return false; // No token found.
+
+                const token_finder_data& data;
+                search_context& context;
+                candidates& found;
+                const char_type* search_begin_end; //!< Tokens starting at or after this position are ignored.
+                bool ignore_case; //!< If true, the ignore case tokens are collected.
+                bool match_case; //!< If true, the tokens matching the case are collected.
+            };
+
+            size_t compiled_size_in_bytes() const
+            {
+                return token_finder.is_compiled() ? token_finder.compiled_size_in_bytes() : 0;
             }
 
-            bool add_token(std::basic_string<char_type> text_to_find, std::basic_string<char_type> replacement_text, bool match_whole_word)
+            const char_type* get_text_to_find(const replacement_entry& entry) const
             {
-                // check if we already have a token for the text to find
-                auto token_begin = text_to_find.cbegin();
-                auto token_end = text_to_find.cend();
+                return texts.data() + entry.text_offset;
+            }
+
+            const char_type* get_replacement_text(const replacement_entry& entry) const
+            {
+                return texts.data() + entry.text_offset + entry.text_length;
+            }
+
+            template<typename sink_type>
+            void write_replacement_text(const replacement_entry& entry, size_t case_form_index, sink_type& sink) const
+            {
+                const char_type* replacement_text = get_replacement_text(entry);
+                if (!entry.preserve_case)
+                {
+                    sink.write(replacement_text, replacement_text + entry.replacement_length);
+                    return;
+                }
+                // The replacement words are written in the case form using a buffer instead of allocating memory.
+                const case_form& form = get_case_form(case_form_index);
+                char_type buffer[256];
+                size_t buffer_size = 0;
+                size_t word_index = 0;
+                size_t character_index = 0;
+                for (const char_type* p = replacement_text; p != replacement_text + entry.replacement_length; ++p)
+                {
+                    if (*p == ' ')
+                    {
+                        ++word_index;
+                        character_index = 0;
+                        if (form.separator == 0)
+                        {
+                            continue;
+                        }
+                        buffer[buffer_size] = form.separator;
+                    }
+                    else
+                    {
+                        buffer[buffer_size] = form.get_character(*p, word_index, character_index++);
+                    }
+                    if (++buffer_size == sizeof(buffer) / sizeof(buffer[0]))
+                    {
+                        sink.write(buffer, buffer + buffer_size);
+                        buffer_size = 0;
+                    }
+                }
+                sink.write(buffer, buffer + buffer_size);
+            }
+
+            // Returns true if the text to find of a preserve case entry in the case form is the found text.
+            bool matches_case_form(const replacement_entry& entry, const case_form& form, const char_type* token_begin, const char_type* token_end) const
+            {
+                const char_type* text_to_find = get_text_to_find(entry);
+                const char_type* token_position = token_begin;
+                size_t word_index = 0;
+                size_t character_index = 0;
+                for (const char_type* p = text_to_find; p != text_to_find + entry.text_length; ++p)
+                {
+                    char_type expected = form.separator;
+                    if (*p == ' ')
+                    {
+                        ++word_index;
+                        character_index = 0;
+                        if (form.separator == 0)
+                        {
+                            continue;
+                        }
+                    }
+                    else
+                    {
+                        expected = form.get_character(*p, word_index, character_index++);
+                    }
+                    if (token_position == token_end || *token_position != expected)
+                    {
+                        return false;
+                    }
+                    ++token_position;
+                }
+                return token_position == token_end;
+            }
+
+            // Returns the index of the first case form from first_form to form_count matching the found text, form_count if
+            // there is none.
+            size_t find_case_form(const replacement_entry& entry, const char_type* token_begin, const char_type* token_end, size_t first_form, size_t form_count) const
+            {
+                for (size_t index = first_form; index < form_count; ++index)
+                {
+                    if (matches_case_form(entry, get_case_form(index), token_begin, token_end))
+                    {
+                        return index;
+                    }
+                }
+                return form_count;
+            }
+
+            // Returns the ignore case entry of the token matching the found text or c_invalid_token_id. Like a
+            // duplicate text to find, a later entry cannot replace this text.
+            token_id_type find_ignore_case_entry(token_id_type token_id, const char_type* token_begin, const char_type* token_end) const
+            {
+                for (token_id_type entry_id = token_id; entry_id != c_invalid_token_id; entry_id = replacement_entries[entry_id].next)
+                {
+                    const auto& entry = replacement_entries[entry_id];
+                    if (entry.ignore_case && matches_text_to_find(entry, token_begin, token_end))
+                    {
+                        return entry_id;
+                    }
+                }
+                return c_invalid_token_id;
+            }
+
+            // Returns the first entry of the token matching the case whose text to find or one of its common case forms
+            // is the found text. Like a duplicate text to find, a later entry cannot replace this text. If there is
+            // no such entry, the first entry matching another case form is returned, c_invalid_token_id if there is none.
+            token_id_type find_match_case_entry(token_id_type token_id, const char_type* token_begin, const char_type* token_end, size_t& case_form_out) const
+            {
+                const auto& first_entry = replacement_entries[token_id];
+                if (first_entry.next == c_invalid_token_id && !first_entry.ignore_case)
+                {
+                    // Most tokens have a single entry, there is only the case to check.
+                    case_form_out = 0;
+                    if (first_entry.preserve_case)
+                    {
+                        case_form_out = find_case_form(first_entry, token_begin, token_end, 0, c_case_form_count);
+                        return case_form_out < c_case_form_count ? token_id : c_invalid_token_id;
+                    }
+                    return matches_text_to_find(first_entry, token_begin, token_end) ? token_id : c_invalid_token_id;
+                }
+                token_id_type other_case_form_entry_id = c_invalid_token_id;
+                size_t other_case_form = 0;
+                for (token_id_type entry_id = token_id; entry_id != c_invalid_token_id; entry_id = replacement_entries[entry_id].next)
+                {
+                    const auto& entry = replacement_entries[entry_id];
+                    if (entry.ignore_case)
+                    {
+                        continue;
+                    }
+                    if (entry.preserve_case)
+                    {
+                        const size_t case_form_index = find_case_form(entry, token_begin, token_end, 0, c_common_case_form_count);
+                        if (case_form_index < c_common_case_form_count)
+                        {
+                            case_form_out = case_form_index;
+                            return entry_id;
+                        }
+                        if (other_case_form_entry_id == c_invalid_token_id)
+                        {
+                            other_case_form = find_case_form(entry, token_begin, token_end, c_common_case_form_count, c_case_form_count);
+                            if (other_case_form < c_case_form_count)
+                            {
+                                other_case_form_entry_id = entry_id;
+                            }
+                        }
+                    }
+                    else if (matches_text_to_find(entry, token_begin, token_end))
+                    {
+                        case_form_out = 0;
+                        return entry_id;
+                    }
+                }
+                case_form_out = other_case_form;
+                return other_case_form_entry_id;
+            }
+
+            bool matches_text_to_find(const replacement_entry& entry, const char_type* token_begin, const char_type* token_end) const
+            {
+                if (entry.ignore_case)
+                {
+                    // The separators of the found text are only equal to the ones of the text to find for the token finder.
+                    return !entry.has_separators || std::equal(token_begin, token_end, get_text_to_find(entry), [](char_type lhs, char_type rhs) { return ascii_ctype::to_lower(lhs) == ascii_ctype::to_lower(rhs); });
+                }
+                return std::equal(token_begin, token_end, get_text_to_find(entry));
+            }
+
+            bool find_token(search_context& context) const
+            {
+                return find_token(context, context.full_text_end, context.full_text_end);
+            }
+
+            // Finds the next token starting before search_begin_end and ending at or before search_end, the whole word
+            // check still uses the full text. At a position, the longest token of each case mode is checked, the ignore
+            // case token wins against the token matching the case. A case mode skips its tokens which are not whole
+            // words as a unit, see token_filter. The tokens starting at or after search_begin_end do not change the
+            // skipped tokens, so the search can continue there with more text.
+            bool find_token(search_context& context, const char_type* search_end, const char_type* search_begin_end) const
+            {
+                candidates found;
+                const token_filter filter(*this, context, found, search_begin_end);
                 token_id_type token_id = c_invalid_token_id;
-                if ( token_finder.find_token(text_to_find, token_begin, token_end, token_id)
-                    && token_begin == text_to_find.begin()
-                    && token_end == text_to_find.end()
-                )
+                const char_type* search_begin = context.current;
+                while (search_begin < search_begin_end && token_finder.find_ranked_token(search_begin, search_end, filter, context.token_begin, context.token_end, token_id))
                 {
+                    if (!found.ignore_case.is_accepted && !found.match_case.is_accepted)
+                    {
+                        // A shorter token was accepted, but the longest tokens of the position are not whole words.
+                        search_begin = context.token_begin + 1;
+                        continue;
+                    }
+                    const bool is_ignore_case = found.ignore_case.is_accepted;
+                    const candidate& accepted = is_ignore_case ? found.ignore_case : found.match_case;
+                    context.token_end = accepted.token_end;
+                    context.token_id = accepted.entry_id;
+                    context.case_form = accepted.case_form;
+                    filter.skip_rejected_tokens();
+                    if (is_ignore_case ? has_match_case_whole_words : has_ignore_case_whole_words)
+                    {
+                        skip_rejected_tokens(context, search_end, !is_ignore_case, is_ignore_case ? found.match_case : found.ignore_case);
+                    }
+                    return true;
+                }
+                filter.skip_rejected_tokens(); // The last position searched.
+                context.token_begin = nullptr; // No token found.
+                context.token_end = nullptr; // No token found.
+                context.token_id = c_invalid_token_id; // No token found.
+                return false;
+            }
+
+            // The case modes are searched as if each had its own search. A case mode skips each token that is not a
+            // whole word as a unit, also if the token overlaps the found token of the other case mode. So the rejected
+            // tokens of the other case mode within the found token are skipped until a token of the case mode is accepted.
+            void skip_rejected_tokens(search_context& context, const char_type* search_end, bool ignore_case, const candidate& at_token_begin) const
+            {
+                if (at_token_begin.is_accepted)
+                {
+                    return; // The case mode searches again after the found token.
+                }
+                const char_type*& resume = ignore_case ? context.ignore_case_resume : context.match_case_resume;
+                candidates found;
+                const token_filter filter(*this, context, found, context.token_end, ignore_case, !ignore_case);
+                const char_type* position = std::max(context.token_begin + 1, resume);
+                while (position < context.token_end)
+                {
+                    const char_type* token_end = nullptr;
+                    token_id_type token_id = c_invalid_token_id;
+                    found = candidates();
+                    token_finder.find_ranked_token_at(position, search_end, filter, token_end, token_id);
+                    const candidate& longest = ignore_case ? found.ignore_case : found.match_case;
+                    if (longest.is_accepted)
+                    {
+                        break;
+                    }
+                    if (longest.token_end != nullptr)
+                    {
+                        resume = longest.token_end;
+                        position = longest.token_end;
+                    }
+                    else
+                    {
+                        ++position;
+                    }
+                }
+            }
+
+            // Collects the new tokens of case_preserve_replacer::add_replacements() to add them to the token finder
+            // at once. The first entry of a token is looked up by the folded token instead of searching the token
+            // finder, which is only searched for the tokens added before the batch.
+            struct token_batch
+            {
+                std::unordered_map<std::basic_string<char_type>, token_id_type> first_entry_ids; //!< The first entries of the folded tokens.
+                std::vector<std::pair<std::basic_string<char_type>, token_id_type>> tokens; //!< The new tokens and their first entries.
+                bool search_token_finder = false; //!< If true, the token finder had tokens before the batch.
+            };
+
+            // Adds the tokens of a batch to the token finder.
+            void add_tokens(token_batch& batch)
+            {
+                token_finder.add_tokens(std::move(batch.tokens));
+                batch.tokens.clear();
+            }
+
+            // Adds the entry of a replacement. In preserve case mode, the words of the text to find are separated by
+            // spaces and the words without separators are added as a second token.
+            bool add_token(const std::basic_string<char_type>& text_to_find, const std::basic_string<char_type>& replacement_text, bool match_whole_word, case_mode mode, token_batch* batch = nullptr)
+            {
+                const size_t text_offset = texts.size();
+                texts.owned().insert(texts.owned().end(), text_to_find.begin(), text_to_find.end());
+                texts.owned().insert(texts.owned().end(), replacement_text.begin(), replacement_text.end());
+                replacement_entry entry(text_offset, text_to_find.size(), replacement_text.size(), match_whole_word, mode);
+                entry.has_separators = std::any_of(text_to_find.begin(), text_to_find.end(), &ascii_ctype::is_separator);
+                bool added = add_entry(text_to_find, entry, batch);
+                if (entry.preserve_case && text_to_find.find(' ') != std::basic_string<char_type>::npos)
+                {
+                    std::basic_string<char_type> words(text_to_find);
+                    words.erase(std::remove(words.begin(), words.end(), static_cast<char_type>(' ')), words.end());
+                    added = add_entry(words, entry, batch) || added;
+                }
+                if (!added)
+                {
+                    texts.owned().resize(text_offset);
                     return false;
                 }
-                token_finder.add_token(text_to_find, replacement_entries.size() /* token_id */);
-                replacement_entries.emplace_back(std::move(replacement_text), match_whole_word);
+                max_token_length = std::max(max_token_length, text_to_find.size());
+                add_whole_word_mode(entry);
                 return true;
             }
+
+            // Remembers if the case mode of the entry has tokens which are skipped if they are not whole words.
+            void add_whole_word_mode(const replacement_entry& entry)
+            {
+                if (entry.match_whole_word)
+                {
+                    (entry.ignore_case ? has_ignore_case_whole_words : has_match_case_whole_words) = true;
+                }
+            }
+
+            // Adds the entry for a token unless an entry of its token already replaces the same texts.
+            bool add_entry(const std::basic_string<char_type>& token, const replacement_entry& entry, token_batch* batch)
+            {
+                // The entry index is the token ID, c_invalid_token_id is not a valid index.
+                const token_id_type entry_id = static_cast<token_id_type>(replacement_entries.size());
+                if (replacement_entries.size() >= static_cast<size_t>(c_invalid_token_id))
+                {
+                    throw std::length_error("Failed to add replacement. There are too many texts to find for the token ID type.");
+                }
+                // check if we already have a token for the text to find
+                const token_id_type token_id = batch != nullptr ? find_first_entry(token, entry_id, *batch) : find_first_entry(token);
+                if (token_id != c_invalid_token_id)
+                {
+                    // The first entry of a case mode wins.
+                    const char_type* text_to_find = get_text_to_find(entry);
+                    token_id_type last_entry_id = token_id;
+                    for (token_id_type existing_entry_id = token_id; existing_entry_id != c_invalid_token_id; existing_entry_id = replacement_entries[existing_entry_id].next)
+                    {
+                        const auto& existing_entry = replacement_entries[existing_entry_id];
+                        const char_type* existing_text_to_find = get_text_to_find(existing_entry);
+                        if (existing_entry.ignore_case == entry.ignore_case && existing_entry.preserve_case == entry.preserve_case && existing_entry.text_length == entry.text_length
+                            && (entry.ignore_case
+                                ? std::equal(text_to_find, text_to_find + entry.text_length, existing_text_to_find, [](char_type lhs, char_type rhs) { return ascii_ctype::to_lower(lhs) == ascii_ctype::to_lower(rhs); })
+                                : std::equal(text_to_find, text_to_find + entry.text_length, existing_text_to_find)))
+                        {
+                            return false;
+                        }
+                        last_entry_id = existing_entry_id;
+                    }
+                    replacement_entries.owned()[last_entry_id].next = entry_id;
+                }
+                else if (batch != nullptr)
+                {
+                    batch->tokens.emplace_back(token, entry_id);
+                }
+                else
+                {
+                    token_finder.add_token(token, entry_id);
+                }
+                replacement_entries.owned().push_back(entry);
+                return true;
+            }
+
+            // Returns the first entry of a token or c_invalid_token_id if the token has not been added.
+            token_id_type find_first_entry(const std::basic_string<char_type>& token) const
+            {
+                auto token_begin = token.cbegin();
+                auto token_end = token.cend();
+                token_id_type token_id = c_invalid_token_id;
+                if (token_finder.find_token(token, token_begin, token_end, token_id) && token_begin == token.begin() && token_end == token.end())
+                {
+                    return token_id;
+                }
+                return c_invalid_token_id;
+            }
+
+            // Returns the first entry of a token added before or by the batch. Otherwise c_invalid_token_id is
+            // returned and the entry is stored as the first entry of the token.
+            token_id_type find_first_entry(const std::basic_string<char_type>& token, token_id_type entry_id, token_batch& batch) const
+            {
+                std::basic_string<char_type> folded_token(token);
+                for (char_type& c : folded_token)
+                {
+                    c = ascii_ctype::fold(c);
+                }
+                const auto inserted = batch.first_entry_ids.emplace(std::move(folded_token), entry_id);
+                if (!inserted.second)
+                {
+                    return inserted.first->second;
+                }
+                const token_id_type token_id = batch.search_token_finder ? find_first_entry(token) : c_invalid_token_id;
+                if (token_id != c_invalid_token_id)
+                {
+                    inserted.first->second = token_id;
+                }
+                return token_id;
+            }
         };
 
-        token_finder_data<cpptokenfinder::token_finder_default_comparer> finder;
-        token_finder_data<token_finder_ignore_case_comparer> i_finder;
+        static const size_t c_compiled_format_magic_size = 8;
+        static const std::uint64_t c_byte_order_mark = 0x0102030405060708; //!< Read as another value in another byte order.
+
+        // The data written by save_compiled() starts with these characters.
+        static const char* get_compiled_format_magic()
+        {
+            return "robolina";
+        }
+
+        // Checks the loaded entries, so their texts and next entries are within the loaded data. The next entry of an
+        // entry has been added after it, so the entries of a token cannot form a loop.
+        static void validate_entries(const replacement_entry* p_entries, size_t entry_count, size_t text_count)
+        {
+            for (size_t i = 0; i < entry_count; ++i)
+            {
+                const replacement_entry& entry = p_entries[i];
+                if (!is_valid_bool(entry.match_whole_word) || !is_valid_bool(entry.ignore_case) || !is_valid_bool(entry.preserve_case) || !is_valid_bool(entry.has_separators)
+                    || (entry.ignore_case && entry.preserve_case)
+                    || entry.text_offset > text_count || entry.text_length == 0 || entry.text_length > text_count - entry.text_offset
+                    || entry.replacement_length > text_count - entry.text_offset - entry.text_length
+                    || (entry.next != c_invalid_token_id && (static_cast<size_t>(entry.next) <= i || static_cast<size_t>(entry.next) >= entry_count)))
+                {
+                    throw std::invalid_argument("Failed to load the replacer. A replacement entry is invalid.");
+                }
+            }
+        }
+
+        // Returns true if the byte of a loaded bool is 0 or 1.
+        static bool is_valid_bool(const bool& value)
+        {
+            return *reinterpret_cast<const unsigned char*>(&value) <= 1;
+        }
+
+        // Adds a replacement rule, the new texts to find are added to the batch if there is one.
+        void add_replacement_implementation(const char_type* text_to_find, const char_type* replacement_text, case_mode mode, bool match_whole_word, typename token_finder_data::token_batch* batch)
+        {
+            throw_if_loaded();
+            if (text_to_find == nullptr)
+            {
+                throw std::invalid_argument("Failed to add replacement. The text to find is null.");
+            }
+            if (*text_to_find == 0)
+            {
+                throw std::invalid_argument("Failed to add replacement. The text to find is empty.");
+            }
+            if (replacement_text == nullptr)
+            {
+                throw std::invalid_argument("Failed to add replacement. The replacement text is null.");
+            }
+
+            if (mode == case_mode::preserve_case)
+            {
+                std::vector<std::basic_string<char_type>> words_to_find = split_text(text_to_find);
+                if (words_to_find.empty())
+                {
+                    throw std::invalid_argument("Failed to add replacement. The text to find does not contain any valid words.");
+                }
+                std::vector<std::basic_string<char_type>> words_of_replacement = split_text(replacement_text);
+                // The words are stored once, the casing of a found text is determined when it is found, see case_form.
+                finder.add_token(to_normal_text(words_to_find), to_normal_text(words_of_replacement), match_whole_word, mode, batch);
+            }
+            else if (mode == case_mode::ignore_case || mode == case_mode::match_case)
+            {
+                finder.add_token(text_to_find, replacement_text, match_whole_word, mode, batch);
+            }
+            else
+            {
+                throw std::invalid_argument("Failed to add replacement. The case mode is invalid.");
+            }
+        }
+
+        void throw_if_loaded() const
+        {
+            if (finder.token_finder.is_loaded())
+            {
+                throw std::logic_error("Failed to add replacement. The replacer has been loaded, replacement rules cannot be added.");
+            }
+        }
+
+        token_finder_data finder;
     };
+
+    template<typename char_type, typename token_id_type>
+    const std::uint32_t case_preserve_replacer<char_type, token_id_type>::c_compiled_format_version;
+
+#if !defined(ROBOLINA_HAS_INLINE_VARIABLES)
+    // Before C++17, a static constexpr data member needs a definition if it is used at runtime.
+    template<typename char_type, typename token_id_type>
+    constexpr unsigned char case_preserve_replacer<char_type, token_id_type>::ascii_ctype::flags[256];
+#endif
 }
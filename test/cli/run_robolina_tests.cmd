@@ -19,6 +19,9 @@ IF EXIST "%TEST_OUTPUT_DIR%" rmdir /s /q "%TEST_OUTPUT_DIR%"
 REM Create a directory for test results
 mkdir "%TEST_OUTPUT_DIR%"
 
+REM The compiled rules of the replacements files are cached in the test output directory, the path must be absolute
+set "XDG_CACHE_HOME=%CD%\%TEST_OUTPUT_DIR%\cache"
+
 mkdir "%TEST_OUTPUT_DIR%\test_help1"
 %ROBOLINA_TOOL% -h > "%TEST_OUTPUT_DIR%\test_help1\help1.txt" || goto :error
 %ROBOLINA_TOOL% --help > "%TEST_OUTPUT_DIR%\test_help1\help2.txt" || goto :error
@@ -83,6 +86,44 @@ REM Test 14: Replace using replacements file with short syntax
 xcopy /E /I /Q "%TEST_INPUT_DIR%" "%TEST_OUTPUT_DIR%\test_replacements_file_short_syntax"
 %ROBOLINA_TOOL% "%TEST_OUTPUT_DIR%\test_replacements_file_short_syntax" --replacements-file "replacements_short_syntax.txt" || goto :error
 
+REM Test 15: Replace recursively verbose using threads
+xcopy /E /I /Q "%TEST_INPUT_DIR%" "%TEST_OUTPUT_DIR%\test_jobs"
+%ROBOLINA_TOOL% "%TEST_OUTPUT_DIR%\test_jobs" "one two three" "four five six" --recursive -v --jobs 4 > "%TEST_OUTPUT_DIR%\test_jobs.txt" || goto :error
+
+REM Test 16: Replace the standard input and write it to the standard output
+%ROBOLINA_TOOL% - "one two three" "four five six" < "%TEST_INPUT_DIR%\testfile1_OneTwoThree.txt" > "%TEST_OUTPUT_DIR%\test_stdin.txt" || goto :error
+
+REM Test 17: Replace using a compiled rules file, the rules file is removed as it depends on the platform
+xcopy /E /I /Q "%TEST_INPUT_DIR%" "%TEST_OUTPUT_DIR%\test_rules_file"
+%ROBOLINA_TOOL% --compile-rules "%TEST_OUTPUT_DIR%\rules.rbl" --replacements-file "replacements.txt" || goto :error
+%ROBOLINA_TOOL% --rules "%TEST_OUTPUT_DIR%\rules.rbl" "%TEST_OUTPUT_DIR%\test_rules_file" || goto :error
+del "%TEST_OUTPUT_DIR%\rules.rbl"
+
+REM Test 18: Replace using the cached rules of a replacements file, the cache is removed as it depends on the platform
+xcopy /E /I /Q "%TEST_INPUT_DIR%" "%TEST_OUTPUT_DIR%\test_cached_rules"
+%ROBOLINA_TOOL% "%TEST_OUTPUT_DIR%\test_cached_rules" --replacements-file "replacements.txt" || goto :error
+IF NOT EXIST "%XDG_CACHE_HOME%\robolina\*.rbl" goto :error
+
+REM Test 19: Replace using the rules loaded from the cache of test 18
+xcopy /E /I /Q "%TEST_INPUT_DIR%" "%TEST_OUTPUT_DIR%\test_cached_rules_loaded"
+%ROBOLINA_TOOL% "%TEST_OUTPUT_DIR%\test_cached_rules_loaded" --replacements-file "replacements.txt" || goto :error
+
+REM Test 20: Replace using a truncated cache, the rules are compiled again and the cache is replaced
+for %%F in ("%XDG_CACHE_HOME%\robolina\*.rbl") do type nul > "%%F"
+xcopy /E /I /Q "%TEST_INPUT_DIR%" "%TEST_OUTPUT_DIR%\test_cached_rules_truncated"
+%ROBOLINA_TOOL% "%TEST_OUTPUT_DIR%\test_cached_rules_truncated" --replacements-file "replacements.txt" || goto :error
+for %%F in ("%XDG_CACHE_HOME%\robolina\*.rbl") do IF %%~zF EQU 0 goto :error
+rmdir /s /q "%XDG_CACHE_HOME%"
+
+REM Test 21: Replace in a file large enough to be memory mapped, it is replaced by a new file
+xcopy /E /I /Q "testlargefile" "%TEST_OUTPUT_DIR%\test_large_file"
+%ROBOLINA_TOOL% "%TEST_OUTPUT_DIR%\test_large_file" "one two three" "four five six" || goto :error
+
+REM Test 22: Replace in a large file with two hard links, it is overwritten in place to keep the links
+xcopy /E /I /Q "testlargefile" "%TEST_OUTPUT_DIR%\test_large_file_linked"
+mklink /H "%TEST_OUTPUT_DIR%\test_large_file_linked\linkedfile_OneTwoThree.txt" "%TEST_OUTPUT_DIR%\test_large_file_linked\largefile_OneTwoThree.txt" > nul || goto :error
+%ROBOLINA_TOOL% "%TEST_OUTPUT_DIR%\test_large_file_linked" "one two three" "four five six" || goto :error
+
 REM Test Error: Missing required positional arguments
 %ROBOLINA_TOOL% "%TEST_OUTPUT_DIR%\dummy" "one two three" 2> "%TEST_OUTPUT_DIR%\bad_missing_args1.txt"
 IF NOT ERRORLEVEL 1 (
@@ -198,6 +239,17 @@ IF NOT ERRORLEVEL 1 (
     echo Error: Expected exit code 1 for bad_value10.txt, got: %ERRORLEVEL%
     exit /b 1
 )
+%ROBOLINA_TOOL% "%TEST_OUTPUT_DIR%\dummy" "one two three" "four five six" --jobs "many" 2> "%TEST_OUTPUT_DIR%\bad_value11.txt"
+IF NOT ERRORLEVEL 1 (
+    echo Error: Expected exit code 1 for bad_value11.txt, got: %ERRORLEVEL%
+    exit /b 1
+)
+
+%ROBOLINA_TOOL% --rules "replacements.txt" "%TEST_OUTPUT_DIR%\dummy" 2> "%TEST_OUTPUT_DIR%\bad_value12.txt"
+IF NOT ERRORLEVEL 1 (
+    echo Error: Expected exit code 1 for bad_value12.txt, got: %ERRORLEVEL%
+    exit /b 1
+)
 
 echo All tests completed successfully.
 exit /b 0
@@ -18,6 +18,9 @@ fi
 # Create a directory for test results
 mkdir -p "$TEST_OUTPUT_DIR"
 
+# The compiled rules of the replacements files are cached in the test output directory, the path must be absolute
+export XDG_CACHE_HOME="$(pwd)/$TEST_OUTPUT_DIR/cache"
+
 mkdir -p "$TEST_OUTPUT_DIR/test_help1"
 $ROBOLINA_TOOL -h > "$TEST_OUTPUT_DIR/test_help1/help1.txt" || { echo "Error: Failed to execute $ROBOLINA_TOOL for help1.txt"; exit 1; }
 $ROBOLINA_TOOL --help > "$TEST_OUTPUT_DIR/test_help1/help2.txt" || { echo "Error: Failed to execute $ROBOLINA_TOOL for help2.txt"; exit 1; }
@@ -78,6 +81,54 @@ $ROBOLINA_TOOL "$TEST_OUTPUT_DIR/test_non_ascii_path_ä" "one two three" "four f
 cp -R "$TEST_INPUT_DIR" "$TEST_OUTPUT_DIR/test_replacements_file_short_syntax"
 $ROBOLINA_TOOL "$TEST_OUTPUT_DIR/test_replacements_file_short_syntax" --replacements-file "replacements_short_syntax.txt" || { echo "Error: Failed to execute $ROBOLINA_TOOL for test_replacements_file_short_syntax"; exit 1; }
 
+# Test 15: Replace recursively verbose using threads
+cp -R "$TEST_INPUT_DIR" "$TEST_OUTPUT_DIR/test_jobs"
+$ROBOLINA_TOOL "$TEST_OUTPUT_DIR/test_jobs" "one two three" "four five six" --recursive -v --jobs 4 > "$TEST_OUTPUT_DIR/test_jobs.txt" || { echo "Error: Failed to execute $ROBOLINA_TOOL for test_jobs"; exit 1; }
+
+# Test 16: Replace the standard input and write it to the standard output
+$ROBOLINA_TOOL - "one two three" "four five six" < "$TEST_INPUT_DIR/testfile1_OneTwoThree.txt" > "$TEST_OUTPUT_DIR/test_stdin.txt" || { echo "Error: Failed to execute $ROBOLINA_TOOL for test_stdin"; exit 1; }
+
+# Test 17: Replace using a compiled rules file, the rules file is removed as it depends on the platform
+cp -R "$TEST_INPUT_DIR" "$TEST_OUTPUT_DIR/test_rules_file"
+$ROBOLINA_TOOL --compile-rules "$TEST_OUTPUT_DIR/rules.rbl" --replacements-file "replacements.txt" || { echo "Error: Failed to execute $ROBOLINA_TOOL for test_rules_file"; exit 1; }
+$ROBOLINA_TOOL --rules "$TEST_OUTPUT_DIR/rules.rbl" "$TEST_OUTPUT_DIR/test_rules_file" || { echo "Error: Failed to execute $ROBOLINA_TOOL for test_rules_file"; exit 1; }
+rm "$TEST_OUTPUT_DIR/rules.rbl"
+
+# Test 18: Replace using the cached rules of a replacements file, the cache is removed as it depends on the platform
+cp -R "$TEST_INPUT_DIR" "$TEST_OUTPUT_DIR/test_cached_rules"
+$ROBOLINA_TOOL "$TEST_OUTPUT_DIR/test_cached_rules" --replacements-file "replacements.txt" || { echo "Error: Failed to execute $ROBOLINA_TOOL for test_cached_rules"; exit 1; }
+CACHED_RULES_FILE="$(ls "$XDG_CACHE_HOME"/robolina/*.rbl 2> /dev/null | head -n 1)"
+if [ -z "$CACHED_RULES_FILE" ]; then
+    echo "Error: No cached rules for test_cached_rules"; exit 1;
+fi
+CACHED_RULES_SIZE=$(wc -c < "$CACHED_RULES_FILE")
+
+# Test 19: Replace using the rules loaded from the cache of test 18
+cp -R "$TEST_INPUT_DIR" "$TEST_OUTPUT_DIR/test_cached_rules_loaded"
+$ROBOLINA_TOOL "$TEST_OUTPUT_DIR/test_cached_rules_loaded" --replacements-file "replacements.txt" || { echo "Error: Failed to execute $ROBOLINA_TOOL for test_cached_rules_loaded"; exit 1; }
+
+# Test 20: Replace using a truncated cache, the rules are compiled again and the cache is replaced
+head -c $((CACHED_RULES_SIZE / 2)) "$CACHED_RULES_FILE" > "$CACHED_RULES_FILE.truncated"
+mv "$CACHED_RULES_FILE.truncated" "$CACHED_RULES_FILE"
+cp -R "$TEST_INPUT_DIR" "$TEST_OUTPUT_DIR/test_cached_rules_truncated"
+$ROBOLINA_TOOL "$TEST_OUTPUT_DIR/test_cached_rules_truncated" --replacements-file "replacements.txt" || { echo "Error: Failed to execute $ROBOLINA_TOOL for test_cached_rules_truncated"; exit 1; }
+if [ "$(wc -c < "$CACHED_RULES_FILE")" -ne "$CACHED_RULES_SIZE" ]; then
+    echo "Error: The truncated cache was not replaced for test_cached_rules_truncated"; exit 1;
+fi
+rm -rf "$XDG_CACHE_HOME"
+
+# Test 21: Replace in a file large enough to be memory mapped, it is replaced by a new file
+cp -R "testlargefile" "$TEST_OUTPUT_DIR/test_large_file"
+$ROBOLINA_TOOL "$TEST_OUTPUT_DIR/test_large_file" "one two three" "four five six" || { echo "Error: Failed to execute $ROBOLINA_TOOL for test_large_file"; exit 1; }
+
+# Test 22: Replace in a large file with two hard links, it is overwritten in place to keep the links
+cp -R "testlargefile" "$TEST_OUTPUT_DIR/test_large_file_linked"
+ln "$TEST_OUTPUT_DIR/test_large_file_linked/largefile_OneTwoThree.txt" "$TEST_OUTPUT_DIR/test_large_file_linked/linkedfile_OneTwoThree.txt"
+$ROBOLINA_TOOL "$TEST_OUTPUT_DIR/test_large_file_linked" "one two three" "four five six" || { echo "Error: Failed to execute $ROBOLINA_TOOL for test_large_file_linked"; exit 1; }
+if [ "$(ls -l "$TEST_OUTPUT_DIR/test_large_file_linked/largefile_FourFiveSix.txt" | awk '{print $2}')" -ne 2 ]; then
+    echo "Error: The hard links were not kept for test_large_file_linked"; exit 1;
+fi
+
 # Test Error: Missing required positional arguments
 $ROBOLINA_TOOL "$TEST_OUTPUT_DIR/dummy" "one two three" 2> "$TEST_OUTPUT_DIR/bad_missing_args1.txt"
 if [ $? -ne 1 ]; then
@@ -171,6 +222,15 @@ $ROBOLINA_TOOL "$TEST_OUTPUT_DIR/test_default" "one two three" "four five six" -
 if [ $? -ne 1 ]; then
     echo "Error: Expected exit code 1 for bad_value10.txt, got $?"; exit 1;
 fi
+$ROBOLINA_TOOL "$TEST_OUTPUT_DIR/dummy" "one two three" "four five six" --jobs "many" 2> "$TEST_OUTPUT_DIR/bad_value11.txt"
+if [ $? -ne 1 ]; then
+    echo "Error: Expected exit code 1 for bad_value11.txt, got $?"; exit 1;
+fi
+
+$ROBOLINA_TOOL --rules "replacements.txt" "$TEST_OUTPUT_DIR/dummy" 2> "$TEST_OUTPUT_DIR/bad_value12.txt"
+if [ $? -ne 1 ]; then
+    echo "Error: Expected exit code 1 for bad_value12.txt, got $?"; exit 1;
+fi
 
 # Print completion message
 echo "All CLI tests completed. Results are stored in $TEST_OUTPUT_DIR."
@@ -0,0 +1,729 @@
+#include <catch2/catch.hpp>
+#include <robolina/cpptokenfinder.hpp>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    const size_t c_invalid_id = static_cast<size_t>(-1);
+
+    class ignore_case_comparer
+    {
+    public:
+        bool operator()(char value_lhs, char value_rhs) const
+        {
+            return std::tolower(static_cast<unsigned char>(value_lhs)) == std::tolower(static_cast<unsigned char>(value_rhs));
+        }
+    };
+
+    // Like ignore_case_comparer, the token finder compares the folded characters.
+    class folding_ignore_case_comparer
+    {
+    public:
+        bool operator()(char value_lhs, char value_rhs) const
+        {
+            return fold(value_lhs) == fold(value_rhs);
+        }
+
+        char fold(char value) const
+        {
+            return static_cast<char>(std::tolower(static_cast<unsigned char>(value)));
+        }
+    };
+
+    // All digits are equal.
+    class digit_class_comparer
+    {
+    public:
+        bool operator()(char value_lhs, char value_rhs) const
+        {
+            return value_lhs == value_rhs || (std::isdigit(static_cast<unsigned char>(value_lhs)) && std::isdigit(static_cast<unsigned char>(value_rhs)));
+        }
+    };
+
+    template <typename comparer_type>
+    using finder_type = cpptokenfinder::token_finder<char, size_t, size_t, c_invalid_id, comparer_type>;
+
+    template <typename comparer_type>
+    using teddy_finder_type = cpptokenfinder::teddy_token_finder<char, size_t, size_t, c_invalid_id, comparer_type>;
+
+    struct found_token
+    {
+        size_t begin = 0;
+        size_t end = 0;
+        size_t id = c_invalid_id;
+
+        bool operator==(const found_token& other) const
+        {
+            return begin == other.begin && end == other.end && id == other.id;
+        }
+    };
+
+    // Finds all tokens the way a replacer does, continuing after the end of each found token.
+    template <typename finder_t>
+    std::vector<found_token> find_all(const finder_t& finder, const std::string& text)
+    {
+        std::vector<found_token> result;
+        const char* current = text.c_str();
+        const char* token_begin = nullptr;
+        const char* token_end = nullptr;
+        size_t token_id = c_invalid_id;
+        while (finder.find_token(current, token_begin, token_end, token_id))
+        {
+            found_token token;
+            token.begin = static_cast<size_t>(token_begin - text.c_str());
+            token.end = static_cast<size_t>(token_end - text.c_str());
+            token.id = token_id;
+            result.push_back(token);
+            current = token_end;
+        }
+        return result;
+    }
+
+    // Finds all tokens in a text given by a character range.
+    template <typename finder_t>
+    std::vector<found_token> find_all_in_range(const finder_t& finder, const std::string& text)
+    {
+        std::vector<found_token> result;
+        const char* text_begin = text.data();
+        const char* text_end = text.data() + text.size();
+        const char* current = text_begin;
+        const char* token_begin = nullptr;
+        const char* token_end = nullptr;
+        size_t token_id = c_invalid_id;
+        while (finder.find_token(current, text_end, token_begin, token_end, token_id))
+        {
+            found_token token;
+            token.begin = static_cast<size_t>(token_begin - text_begin);
+            token.end = static_cast<size_t>(token_end - text_begin);
+            token.id = token_id;
+            result.push_back(token);
+            current = token_end;
+        }
+        return result;
+    }
+
+    // Finds all tokens by comparing each token at each text position.
+    template <typename comparer_type>
+    std::vector<found_token> find_all_naive(const std::vector<std::string>& tokens, const std::string& text)
+    {
+        comparer_type comparer;
+        std::vector<found_token> result;
+        size_t position = 0;
+        while (position < text.size())
+        {
+            found_token token;
+            for (size_t id = 0; id < tokens.size(); ++id)
+            {
+                const std::string& candidate = tokens[id];
+                if (candidate.empty() || candidate.size() > text.size() - position || candidate.size() <= token.end - token.begin)
+                {
+                    continue;
+                }
+                bool matches = true;
+                for (size_t i = 0; i < candidate.size() && matches; ++i)
+                {
+                    matches = comparer(candidate[i], text[position + i]);
+                }
+                if (matches)
+                {
+                    token.begin = position;
+                    token.end = position + candidate.size();
+                    token.id = id;
+                }
+            }
+            if (token.id != c_invalid_id)
+            {
+                result.push_back(token);
+                position = token.end;
+            }
+            else
+            {
+                ++position;
+            }
+        }
+        return result;
+    }
+
+    std::string random_text(std::mt19937& generator, const char* alphabet, size_t max_length)
+    {
+        std::uniform_int_distribution<size_t> length_distribution(1, max_length);
+        std::uniform_int_distribution<size_t> character_distribution(0, std::char_traits<char>::length(alphabet) - 1);
+        std::string text(length_distribution(generator), ' ');
+        for (char& c : text)
+        {
+            c = alphabet[character_distribution(generator)];
+        }
+        return text;
+    }
+
+    template <typename comparer_type>
+    void require_compiled_search_matches(const char* alphabet, unsigned seed)
+    {
+        std::mt19937 generator(seed);
+        for (int round = 0; round < 50; ++round)
+        {
+            finder_type<comparer_type> finder;
+            for (size_t id = 0; id < 20; ++id)
+            {
+                std::string token = random_text(generator, alphabet, 6);
+                try
+                {
+                    finder.add_token(token, id);
+                }
+                catch (const std::invalid_argument&)
+                {
+                    // Duplicate token, ignored.
+                }
+            }
+            finder_type<comparer_type> compiled_finder = finder;
+            compiled_finder.compile();
+            REQUIRE(compiled_finder.is_compiled());
+            REQUIRE_FALSE(finder.is_compiled());
+
+            for (int text_round = 0; text_round < 20; ++text_round)
+            {
+                std::string text = random_text(generator, alphabet, 60);
+                REQUIRE(find_all(compiled_finder, text) == find_all(finder, text));
+            }
+        }
+    }
+
+    template <typename comparer_type>
+    void require_teddy_search_matches(const char* token_alphabet, const char* text_alphabet, unsigned seed)
+    {
+        std::mt19937 generator(seed);
+        for (int round = 0; round < 40; ++round)
+        {
+            finder_type<comparer_type> finder;
+            teddy_finder_type<comparer_type> teddy_finder;
+            const size_t token_count = 1 + generator() % 40;
+            for (size_t id = 0; id < token_count; ++id)
+            {
+                std::string token = random_text(generator, token_alphabet, 1 + round % 6);
+                try
+                {
+                    finder.add_token(token, id);
+                    teddy_finder.add_token(token, id);
+                }
+                catch (const std::invalid_argument&)
+                {
+                    // Duplicate token, ignored.
+                }
+            }
+            teddy_finder.compile();
+            REQUIRE(teddy_finder.is_compiled());
+            REQUIRE(teddy_finder.get_fingerprint_length() >= 1);
+            REQUIRE(teddy_finder.get_fingerprint_length() <= 4);
+
+            for (int text_round = 0; text_round < 10; ++text_round)
+            {
+                std::string text = random_text(generator, text_alphabet, 200);
+                std::vector<found_token> expected = find_all_in_range(finder, text);
+                REQUIRE(find_all_in_range(teddy_finder, text) == expected);
+                REQUIRE(find_all(teddy_finder, text) == find_all(finder, text));
+            }
+        }
+    }
+}
+
+TEST_CASE("Compiled token finder", "[cpptokenfinder]")
+{
+    finder_type<cpptokenfinder::token_finder_default_comparer> finder;
+    finder.add_token("auto", 0);
+    finder.add_token("do", 1);
+    finder.add_token("double", 2);
+    finder.add_token("dolphin", 3);
+    finder.add_token("bc", 4);
+    finder.add_token("abcd", 5);
+    finder.compile();
+
+    SECTION("Longest token wins") {
+        std::string text = "The house has a double garage.";
+        std::vector<found_token> tokens = find_all(finder, text);
+        REQUIRE(tokens.size() == 1);
+        REQUIRE(tokens[0].begin == 16);
+        REQUIRE(tokens[0].end == 22);
+        REQUIRE(tokens[0].id == 2);
+    }
+
+    SECTION("Leftmost token wins over an earlier ending token") {
+        std::vector<found_token> tokens = find_all(finder, std::string("xabcd"));
+        REQUIRE(tokens.size() == 1);
+        REQUIRE(tokens[0].begin == 1);
+        REQUIRE(tokens[0].id == 5);
+    }
+
+    SECTION("Shorter token after a failed longer one") {
+        std::vector<found_token> tokens = find_all(finder, std::string("dolphiauto abc"));
+        REQUIRE(tokens.size() == 3);
+        REQUIRE(tokens[0].id == 1);
+        REQUIRE(tokens[1].id == 0);
+        REQUIRE(tokens[2].id == 4);
+    }
+
+    SECTION("Adding a token discards the compiled state") {
+        finder.add_token("house", 6);
+        REQUIRE_FALSE(finder.is_compiled());
+        std::vector<found_token> tokens = find_all(finder, std::string("house"));
+        REQUIRE(tokens.size() == 1);
+        REQUIRE(tokens[0].id == 6);
+    }
+}
+
+TEST_CASE("Compiled token finder matches the uncompiled search", "[cpptokenfinder]")
+{
+    SECTION("Default comparer") {
+        require_compiled_search_matches<cpptokenfinder::token_finder_default_comparer>("ab", 1);
+        require_compiled_search_matches<cpptokenfinder::token_finder_default_comparer>("abcd", 2);
+    }
+
+    SECTION("Ignore case comparer") {
+        require_compiled_search_matches<ignore_case_comparer>("aAbB", 3);
+        require_compiled_search_matches<ignore_case_comparer>("aBcD", 4);
+    }
+}
+
+TEST_CASE("Token finder skips characters that cannot start a token", "[cpptokenfinder]")
+{
+    std::mt19937 generator(5);
+    for (int round = 0; round < 40; ++round)
+    {
+        // Few distinct first characters in long texts, so the vectorized scan is used.
+        std::vector<std::string> tokens;
+        finder_type<ignore_case_comparer> finder;
+        for (size_t id = 0; id < 6; ++id)
+        {
+            std::string token = random_text(generator, round % 2 ? "xyz" : "q\xe4.", 4);
+            tokens.push_back(token);
+            try
+            {
+                finder.add_token(token, id);
+            }
+            catch (const std::invalid_argument&)
+            {
+                tokens.back().clear(); // Duplicate token, ignored.
+            }
+        }
+        finder_type<ignore_case_comparer> compiled_finder = finder;
+        compiled_finder.compile();
+
+        for (int text_round = 0; text_round < 10; ++text_round)
+        {
+            std::string text = random_text(generator, "abcdefghijklmnopqrstuvw 0123456789\n\t", 300);
+            std::string insert = random_text(generator, "xyzXYZqQ\xe4\xc4.", 8);
+            text.insert(static_cast<size_t>(generator() % text.size()), insert);
+            std::vector<found_token> expected = find_all_naive<ignore_case_comparer>(tokens, text);
+            REQUIRE(find_all_in_range(finder, text) == expected);
+            REQUIRE(find_all_in_range(compiled_finder, text) == expected);
+            REQUIRE(find_all(finder, text) == expected);
+            REQUIRE(find_all(compiled_finder, text) == expected);
+        }
+    }
+}
+
+TEST_CASE("Teddy token finder", "[cpptokenfinder]")
+{
+    teddy_finder_type<cpptokenfinder::token_finder_default_comparer> finder;
+    finder.add_token("auto", 0);
+    finder.add_token("do", 1);
+    finder.add_token("double", 2);
+    finder.add_token("dolphin", 3);
+    finder.add_token("bc", 4);
+    finder.add_token("abcd", 5);
+    REQUIRE(finder.get_fingerprint_length() == 0);
+    finder.compile();
+    REQUIRE(finder.get_fingerprint_length() == 2);
+    REQUIRE(finder.compiled_size_in_bytes() > 0);
+
+    SECTION("Longest token wins") {
+        std::string text = "The house has a double garage. The house has a double garage.";
+        std::vector<found_token> tokens = find_all_in_range(finder, text);
+        REQUIRE(tokens.size() == 2);
+        REQUIRE(tokens[0].begin == 16);
+        REQUIRE(tokens[0].end == 22);
+        REQUIRE(tokens[0].id == 2);
+        REQUIRE(tokens[1].begin == 47);
+        REQUIRE(tokens[1].id == 2);
+    }
+
+    SECTION("Leftmost token wins over an earlier ending token") {
+        std::vector<found_token> tokens = find_all(finder, std::string("xabcd"));
+        REQUIRE(tokens.size() == 1);
+        REQUIRE(tokens[0].begin == 1);
+        REQUIRE(tokens[0].id == 5);
+    }
+
+    SECTION("Text shorter than the fingerprint") {
+        REQUIRE(find_all(finder, std::string("d")).empty());
+        REQUIRE(find_all(finder, std::string("")).empty());
+    }
+
+    SECTION("Null-terminated text searched in several blocks") {
+        // The null-terminated text is searched block by block, the tokens are found at any position near the block
+        // ends, also if they continue after the end of a block.
+        const char* tokens[] = { "do", "double", "abcd" };
+        for (const char* token : tokens)
+        {
+            for (size_t position = 0; position < 2100; ++position)
+            {
+                std::string text = std::string(position, 'x') + token + std::string(100, 'x');
+                std::vector<found_token> found = find_all(finder, text);
+                REQUIRE(found == find_all_in_range(finder, text));
+                REQUIRE(found.size() == 1);
+            }
+        }
+    }
+
+    SECTION("Adding a token discards the fingerprint") {
+        finder.add_token("x", 6);
+        REQUIRE(finder.get_fingerprint_length() == 0);
+        REQUIRE(find_all(finder, std::string("xabcd")).size() == 2);
+        finder.compile();
+        REQUIRE(finder.get_fingerprint_length() == 1);
+        REQUIRE(find_all(finder, std::string("xabcd")).size() == 2);
+    }
+
+    SECTION("Clear") {
+        finder.clear();
+        REQUIRE_FALSE(finder.is_compiled());
+        REQUIRE(finder.get_fingerprint_length() == 0);
+        REQUIRE(find_all(finder, std::string("double")).empty());
+    }
+}
+
+TEST_CASE("Teddy token finder matches the search tree", "[cpptokenfinder]")
+{
+    SECTION("Default comparer") {
+        require_teddy_search_matches<cpptokenfinder::token_finder_default_comparer>("ab", "abc", 6);
+        require_teddy_search_matches<cpptokenfinder::token_finder_default_comparer>("abcdefgh\xe4\xf6", "abcdefghijklmnopqrstuvwxyz \xe4\xf6\xc4", 7);
+    }
+
+    SECTION("Ignore case comparer") {
+        require_teddy_search_matches<ignore_case_comparer>("abcd", "aAbBcCdDeE ", 8);
+        require_teddy_search_matches<ignore_case_comparer>("xyz", "abcdefghijklmnopqrstuvwxyzXYZ 0123456789", 9);
+    }
+
+    SECTION("Comparer matching many prefixes") {
+        require_teddy_search_matches<digit_class_comparer>("07a", "0123456789ab", 10);
+    }
+}
+
+TEST_CASE("Token finder folding the characters", "[cpptokenfinder]")
+{
+    SECTION("Tokens with a common prefix in different case") {
+        finder_type<folding_ignore_case_comparer> finder;
+        finder.add_token("XYZ", 0);
+        finder.add_token("xyq", 1);
+        REQUIRE_THROWS_AS(finder.add_token("xYz", 2), std::invalid_argument);
+        std::vector<found_token> tokens = find_all(finder, std::string("xyzXYQ"));
+        REQUIRE(tokens.size() == 2);
+        REQUIRE(tokens[0].id == 0);
+        REQUIRE(tokens[1].id == 1);
+        finder.compile();
+        REQUIRE(find_all(finder, std::string("xyzXYQ")) == tokens);
+    }
+
+    SECTION("Same tokens as comparing each character") {
+        std::mt19937 generator(11);
+        for (int round = 0; round < 40; ++round)
+        {
+            std::vector<std::string> tokens;
+            finder_type<folding_ignore_case_comparer> finder;
+            teddy_finder_type<folding_ignore_case_comparer> teddy_finder;
+            for (size_t id = 0; id < 8; ++id)
+            {
+                std::string token = random_text(generator, "aAbBcC\xe4\xc4", 4);
+                tokens.push_back(token);
+                try
+                {
+                    finder.add_token(token, id);
+                    teddy_finder.add_token(token, id);
+                }
+                catch (const std::invalid_argument&)
+                {
+                    tokens.back().clear(); // Same token in different case, ignored.
+                }
+            }
+            finder_type<folding_ignore_case_comparer> compiled_finder = finder;
+            compiled_finder.compile();
+            teddy_finder.compile();
+
+            for (int text_round = 0; text_round < 10; ++text_round)
+            {
+                std::string text = random_text(generator, "aAbBcCdD\xe4\xc4 ", 100);
+                std::vector<found_token> expected = find_all_naive<ignore_case_comparer>(tokens, text);
+                REQUIRE(find_all(finder, text) == expected);
+                REQUIRE(find_all(compiled_finder, text) == expected);
+                REQUIRE(find_all_in_range(teddy_finder, text) == expected);
+            }
+        }
+    }
+
+    SECTION("Compiled search of characters above 255") {
+        cpptokenfinder::token_finder<wchar_t, size_t, size_t, c_invalid_id> finder;
+        finder.add_token(L"\u4e00\u4e8c", 0);
+        finder.add_token(L"\u4e8c\u4e09", 1);
+        finder.add_token(L"a\u0100", 2);
+        finder.compile();
+        std::wstring text = L"\u4e00\u4e00\u4e8c\u4e09 a\u0100 \u0101";
+        const wchar_t* token_begin = nullptr;
+        const wchar_t* token_end = nullptr;
+        size_t token_id = c_invalid_id;
+        REQUIRE(finder.find_token(text.c_str(), token_begin, token_end, token_id));
+        REQUIRE(token_begin == text.c_str() + 1);
+        REQUIRE(token_id == 0);
+        REQUIRE(finder.find_token(token_end, token_begin, token_end, token_id));
+        REQUIRE(token_begin == text.c_str() + 5);
+        REQUIRE(token_id == 2);
+        REQUIRE_FALSE(finder.find_token(token_end, token_begin, token_end, token_id));
+    }
+}
+
+TEST_CASE("Token finder with a filter ranking the tokens", "[cpptokenfinder]")
+{
+    // Accepts the even token IDs, the token IDs below 10 rank higher.
+    struct even_token_filter
+    {
+        size_t operator()(size_t token_id, const char* /*token_begin*/, const char* /*token_end*/) const
+        {
+            return token_id % 2 != 0 ? 0 : (token_id < 10 ? 2 : 1);
+        }
+    };
+
+    finder_type<cpptokenfinder::token_finder_default_comparer> finder;
+    finder.add_token("do", 12);
+    finder.add_token("dou", 14);
+    finder.add_token("doub", 2);
+    finder.add_token("double", 16);
+    finder.add_token("ab", 1);
+    finder.add_token("bc", 4);
+    const even_token_filter filter;
+
+    for (int compiled = 0; compiled < 2; ++compiled)
+    {
+        if (compiled)
+        {
+            finder.compile();
+        }
+
+        const std::string text = "abc double";
+        const char* token_begin = nullptr;
+        const char* token_end = nullptr;
+        size_t token_id = c_invalid_id;
+
+        // The rejected token ab does not hide bc.
+        REQUIRE(finder.find_ranked_token(text.c_str(), filter, token_begin, token_end, token_id));
+        REQUIRE(token_begin == text.c_str() + 1);
+        REQUIRE(token_id == 4);
+
+        // The highest rank wins, not the longest token.
+        REQUIRE(finder.find_ranked_token(text.data() + 3, text.data() + text.size(), filter, token_begin, token_end, token_id));
+        REQUIRE(token_begin == text.c_str() + 4);
+        REQUIRE(token_end == text.c_str() + 8);
+        REQUIRE(token_id == 2);
+
+        // Only tokens starting at the position are found.
+        REQUIRE_FALSE(finder.find_ranked_token_at(text.c_str() + 3, filter, token_end, token_id));
+        REQUIRE(finder.find_ranked_token_at(text.c_str() + 4, filter, token_end, token_id));
+        REQUIRE(token_id == 2);
+    }
+}
+
+TEST_CASE("Copied token finder", "[cpptokenfinder]")
+{
+    finder_type<cpptokenfinder::token_finder_default_comparer> finder;
+    REQUIRE(finder.search_tree_size_in_bytes() == 0);
+    finder.add_token("auto", 1);
+    finder.add_token("do", 2);
+    finder.add_token("double", 3);
+    const size_t size = finder.search_tree_size_in_bytes();
+    REQUIRE(size > 0);
+
+    finder_type<cpptokenfinder::token_finder_default_comparer> copy(finder);
+    REQUIRE(copy.search_tree_size_in_bytes() == size);
+    copy.add_token("dolphin", 4);
+    REQUIRE(finder.search_tree_size_in_bytes() == size);
+
+    const std::string text = "auto dolphin double";
+    REQUIRE(find_all(copy, text).size() == 3);
+    REQUIRE(find_all(finder, text).size() == 3);
+    REQUIRE(find_all(finder, text)[1] == found_token{ 5, 7, 2 });
+    REQUIRE(find_all(copy, text)[1] == found_token{ 5, 12, 4 });
+
+    finder = copy;
+    REQUIRE(find_all(finder, text) == find_all(copy, text));
+
+    finder.clear();
+    REQUIRE(finder.search_tree_size_in_bytes() == 0);
+    REQUIRE(find_all(finder, text).empty());
+    REQUIRE(find_all(copy, text).size() == 3);
+}
+
+TEST_CASE("Large token finder", "[cpptokenfinder]")
+{
+    // Many tokens sharing prefixes let the entry lists grow and reuse the memory of the smaller lists.
+    finder_type<cpptokenfinder::token_finder_default_comparer> finder;
+    std::vector<std::string> tokens;
+    for (char first = 'a'; first <= 'z'; ++first)
+    {
+        for (char second = 'a'; second <= 'z'; ++second)
+        {
+            for (size_t length = 1; length <= 3; ++length)
+            {
+                tokens.push_back(std::string(1, first) + std::string(length, second));
+            }
+        }
+    }
+    for (size_t i = 0; i < tokens.size(); ++i)
+    {
+        finder.add_token(tokens[i], i);
+    }
+    const size_t size = finder.search_tree_size_in_bytes();
+    REQUIRE(size > 0);
+
+    finder_type<cpptokenfinder::token_finder_default_comparer> copy(finder);
+    finder_type<cpptokenfinder::token_finder_default_comparer> moved(std::move(finder));
+    REQUIRE(finder.search_tree_size_in_bytes() == 0);
+    REQUIRE(moved.search_tree_size_in_bytes() == size);
+    for (size_t i = 0; i < tokens.size(); ++i)
+    {
+        const std::string text = "(" + tokens[i] + ")";
+        REQUIRE(find_all(moved, text) == std::vector<found_token>{ found_token{ 1, tokens[i].size() + 1, i } });
+        REQUIRE(find_all(copy, text) == std::vector<found_token>{ found_token{ 1, tokens[i].size() + 1, i } });
+    }
+}
+
+TEST_CASE("Token finder adding several tokens", "[cpptokenfinder]")
+{
+    typedef std::vector<std::pair<std::string, size_t>> token_list;
+
+    SECTION("Same tokens as adding each token") {
+        std::mt19937 generator(5);
+        for (int round = 0; round < 50; ++round)
+        {
+            finder_type<folding_ignore_case_comparer> finder;
+            token_list tokens;
+            for (size_t id = 0; id < 30; ++id)
+            {
+                std::string token = random_text(generator, "aAbBc", 6);
+                try
+                {
+                    finder.add_token(token, id);
+                    tokens.push_back(std::make_pair(token, id));
+                }
+                catch (const std::invalid_argument&)
+                {
+                    // Duplicate token, ignored.
+                }
+            }
+            finder_type<folding_ignore_case_comparer> batch_finder;
+            batch_finder.add_tokens(tokens);
+
+            for (int text_round = 0; text_round < 20; ++text_round)
+            {
+                std::string text = random_text(generator, "aAbBcd", 60);
+                REQUIRE(find_all(batch_finder, text) == find_all(finder, text));
+            }
+            finder.compile();
+            batch_finder.compile();
+            std::string text = random_text(generator, "aAbBcd", 200);
+            REQUIRE(find_all(batch_finder, text) == find_all(finder, text));
+        }
+    }
+
+    SECTION("Tokens added to a finder with tokens") {
+        finder_type<cpptokenfinder::token_finder_default_comparer> finder;
+        finder.add_token("do", 1);
+        finder.compile();
+        finder.add_tokens(token_list{ { "double", 2 }, { "auto", 3 } });
+        REQUIRE_FALSE(finder.is_compiled());
+        REQUIRE(find_all(finder, std::string("auto do double")) == std::vector<found_token>{ found_token{ 0, 4, 3 }, found_token{ 5, 7, 1 }, found_token{ 8, 14, 2 } });
+        REQUIRE_THROWS_AS(finder.add_tokens(token_list{ { "do", 4 } }), std::invalid_argument);
+    }
+
+    SECTION("Invalid tokens") {
+        finder_type<folding_ignore_case_comparer> finder;
+        REQUIRE_THROWS_AS(finder.add_tokens(token_list{ { "Do", 1 }, { "dO", 2 } }), std::invalid_argument);
+        REQUIRE_THROWS_AS(finder.add_tokens(token_list{ { "do", 1 }, { "", 2 } }), std::invalid_argument);
+        REQUIRE_THROWS_AS(finder.add_tokens(token_list{ { "do", c_invalid_id } }), std::invalid_argument);
+        REQUIRE(finder.search_tree_size_in_bytes() == 0);
+    }
+}
+
+TEST_CASE("Loaded compiled token finder", "[cpptokenfinder]")
+{
+    std::mt19937 generator(7);
+    finder_type<folding_ignore_case_comparer> finder;
+    for (size_t id = 0; id < 200; ++id)
+    {
+        finder.add_token(random_text(generator, "abcdefgh", 6) + std::to_string(id), id);
+    }
+    std::vector<char> data;
+    REQUIRE_THROWS_AS(finder.save_compiled(data), std::logic_error);
+    finder.compile();
+    finder.save_compiled(data);
+    REQUIRE(data.size() % 8 == 0);
+    // Aligned to 8 bytes like a memory-mapped file.
+    std::vector<std::uint64_t> aligned_data(data.size() / 8);
+    std::memcpy(aligned_data.data(), data.data(), data.size());
+    const char* p_data = reinterpret_cast<const char*>(aligned_data.data());
+    const char* p_data_end = p_data + data.size();
+    const std::string text = random_text(generator, "aAbBcCdDeEfFgGhH0123456789", 2000);
+
+    SECTION("Same tokens as the saved token finder") {
+        finder_type<folding_ignore_case_comparer> loaded_finder;
+        loaded_finder.add_token("abc", 1000);
+        REQUIRE(loaded_finder.load_compiled(p_data, p_data_end) == p_data_end);
+        REQUIRE(loaded_finder.is_compiled());
+        REQUIRE(loaded_finder.is_loaded());
+        REQUIRE(find_all(loaded_finder, text) == find_all(finder, text));
+
+        teddy_finder_type<folding_ignore_case_comparer> teddy_finder;
+        teddy_finder.load_compiled(p_data, p_data_end);
+        REQUIRE(find_all(teddy_finder, text) == find_all(finder, text));
+    }
+
+    SECTION("Tokens cannot be added to a loaded token finder") {
+        finder_type<folding_ignore_case_comparer> loaded_finder;
+        loaded_finder.load_compiled(p_data, p_data_end);
+        REQUIRE_THROWS_AS(loaded_finder.add_token("xyz", 1000), std::logic_error);
+        REQUIRE_THROWS_AS(loaded_finder.add_tokens(std::vector<std::pair<std::string, size_t>>{ { "xyz", 1000 } }), std::logic_error);
+        loaded_finder.compile();
+        REQUIRE(find_all(loaded_finder, text) == find_all(finder, text));
+        loaded_finder.clear();
+        REQUIRE_FALSE(loaded_finder.is_loaded());
+        loaded_finder.add_token("xyz", 1000);
+        REQUIRE(find_all(loaded_finder, std::string("axyz")) == std::vector<found_token>{ found_token{ 1, 4, 1000 } });
+    }
+
+    SECTION("Invalid data") {
+        finder_type<folding_ignore_case_comparer> loaded_finder;
+        REQUIRE_THROWS_AS(loaded_finder.load_compiled(p_data, p_data_end - 8), std::invalid_argument);
+        REQUIRE_THROWS_AS(loaded_finder.load_compiled(p_data + 1, p_data_end), std::invalid_argument);
+        REQUIRE_THROWS_AS(loaded_finder.load_compiled(p_data, p_data_end, [](size_t id, size_t) { return id < 100; }), std::invalid_argument);
+        REQUIRE_FALSE(loaded_finder.is_compiled());
+
+        cpptokenfinder::token_finder<wchar_t, size_t, size_t, c_invalid_id> wide_finder;
+        REQUIRE_THROWS_AS(wide_finder.load_compiled(p_data, p_data_end), std::invalid_argument);
+
+        // A state following the root gets a wrong depth. The states follow a header of four values, the second
+        // one is the size of a state, which starts with base, check, failure, output and depth.
+        const size_t state_size = static_cast<size_t>(aligned_data[1]);
+        size_t state_offset = 32 + state_size;
+        std::uint32_t check = 1;
+        for (; check != 0; state_offset += state_size)
+        {
+            std::memcpy(&check, &data[state_offset + 4], 4);
+        }
+        const std::uint32_t depth = 2;
+        std::memcpy(&data[state_offset - state_size + 16], &depth, 4);
+        std::memcpy(aligned_data.data(), data.data(), data.size());
+        REQUIRE_THROWS_AS(loaded_finder.load_compiled(p_data, p_data_end), std::invalid_argument);
+    }
+}
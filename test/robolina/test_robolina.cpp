@@ -1,7 +1,11 @@
 #define CATCH_CONFIG_MAIN  // This tells Catch to provide a main() - only do this in one cpp file
 #include <catch2/catch.hpp>
 #include <robolina/robolina.hpp>
+#include <cstdint>
+#include <cstring>
+#include <random>
 #include <string>
+#include <vector>
 
 // Helper function to create a replacer with a single rule
 template<typename CharType>
@@ -104,6 +108,61 @@ TEST_CASE("Preserve case variants", "[robolina]")
     }
 }
 
+TEST_CASE("Other preserve case forms", "[robolina]")
+{
+    auto replacer = create_replacer<char>("one two three", "four five six", robolina::case_mode::preserve_case);
+
+    SECTION("Capitalized words with separators") {
+        REQUIRE(replacer.find_and_replace(std::string("One-Two-Three One_Two_Three One Two Three")) == "Four-Five-Six Four_Five_Six Four Five Six");
+    }
+
+    SECTION("Lowercase and uppercase words separated by spaces") {
+        REQUIRE(replacer.find_and_replace(std::string("ONE TWO THREE")) == "FOUR FIVE SIX");
+    }
+
+    SECTION("Mixed separators and casings do not match") {
+        const std::string input = "one_two-three One_two_three oNe_two_three";
+        REQUIRE(replacer.find_and_replace(input) == input);
+    }
+
+    SECTION("Edits of other case forms") {
+        const std::string input = "x One-Two-Three";
+        std::vector<robolina::case_preserve_replacer<char>::edit> edits;
+        replacer.find_edits(input.data(), input.data() + input.size(), edits);
+        REQUIRE(edits.size() == 1);
+        REQUIRE(replacer.get_replacement_text(edits[0].replacement_id) == "Four-Five-Six");
+    }
+}
+
+TEST_CASE("Preserve case forms of several rules", "[robolina]")
+{
+    robolina::case_preserve_replacer<char> replacer;
+
+    SECTION("Words of the text to find without separators") {
+        replacer.add_replacement("getHTTP response", "fetch URL", robolina::case_mode::preserve_case);
+        REQUIRE(replacer.find_and_replace(std::string("getHTTPresponse get_HTTP_response")) == "fetchURL fetch_URL");
+    }
+
+    SECTION("The first rule of a common case form wins") {
+        replacer.add_replacement("one two", "x y", robolina::case_mode::preserve_case);
+        replacer.add_replacement("One Two", "z", robolina::case_mode::preserve_case);
+        replacer.add_replacement("oneTwo", "w", robolina::case_mode::match_case);
+        REQUIRE(replacer.find_and_replace(std::string("One Two oneTwo one two")) == "z xY x y");
+    }
+
+    SECTION("A common case form wins against the other ones of an earlier rule") {
+        replacer.add_replacement("one two", "x y", robolina::case_mode::preserve_case);
+        replacer.add_replacement("ONE TWO", "z", robolina::case_mode::preserve_case);
+        REQUIRE(replacer.find_and_replace(std::string("ONE TWO One Two")) == "z X Y");
+    }
+
+    SECTION("A text of an earlier rule failing the whole word check is not replaced by a later rule") {
+        replacer.add_replacement("t wo", "x", robolina::case_mode::preserve_case, true);
+        replacer.add_replacement("two", "y", robolina::case_mode::preserve_case);
+        REQUIRE(replacer.find_and_replace(std::string("two atwo ab_two")) == "x atwo ab_x");
+    }
+}
+
 TEST_CASE("Match case mode", "[robolina]")
 {
     auto replacer = create_replacer<char>("one two three", "four five six", robolina::case_mode::match_case);
@@ -148,6 +207,20 @@ TEST_CASE("Ignore case mode", "[robolina]")
     }
 }
 
+TEST_CASE("Ignore case rules with a common prefix in different case", "[robolina]")
+{
+    robolina::case_preserve_replacer<char> replacer;
+    replacer.add_replacement("XYZ", "one", robolina::case_mode::ignore_case);
+    replacer.add_replacement("xyq", "two", robolina::case_mode::ignore_case);
+    replacer.add_replacement("Xyz", "three", robolina::case_mode::ignore_case); // Same rule as the first one, ignored.
+
+    std::string input = "xyz XYQ xYz xyQ";
+    std::string expected = "one two one two";
+    REQUIRE(replacer.find_and_replace(input) == expected);
+    replacer.compile();
+    REQUIRE(replacer.find_and_replace(input) == expected);
+}
+
 TEST_CASE("Match whole word option", "[robolina]")
 {
     auto replacer = create_replacer<char>("one", "four", robolina::case_mode::preserve_case, true);
@@ -188,6 +261,47 @@ TEST_CASE("Multiple replacements with different modes", "[robolina]")
     }
 }
 
+TEST_CASE("Add several replacements", "[robolina]")
+{
+    typedef robolina::case_preserve_replacer<char> replacer_type;
+    const std::vector<replacer_type::replacement> replacements = {
+        { "one two", "four five", robolina::case_mode::preserve_case, false },
+        { "ONE_TWO", "x", robolina::case_mode::match_case, false },
+        { "one-two", "y", robolina::case_mode::ignore_case, true },
+        { "OneTwo", "z", robolina::case_mode::preserve_case, false },
+        { "three", "six", robolina::case_mode::ignore_case, false },
+        { "Three", "seven", robolina::case_mode::match_case, false },
+        { "THREE", "eight", robolina::case_mode::ignore_case, false },
+        { "t", "u", robolina::case_mode::match_case, true }
+    };
+    const std::string input = "one two ONE_TWO One-Two oneTwo xone_two THREE three Three t tt";
+
+    SECTION("Same results as adding each replacement") {
+        replacer_type replacer;
+        for (const auto& replacement : replacements)
+        {
+            replacer.add_replacement(replacement.text_to_find.c_str(), replacement.replacement_text.c_str(), replacement.mode, replacement.match_whole_word);
+        }
+        replacer_type batch_replacer;
+        batch_replacer.add_replacements(replacements);
+        REQUIRE(batch_replacer.find_and_replace(input) == replacer.find_and_replace(input));
+        REQUIRE(batch_replacer.find_and_replace(input) == "four five FOUR_FIVE y fourFive xfour_five six six six u tt");
+    }
+
+    SECTION("Replacements added to a replacer with replacements") {
+        replacer_type replacer;
+        replacer.add_replacement("one two", "nine", robolina::case_mode::preserve_case);
+        replacer.add_replacements(replacements);
+        REQUIRE(replacer.find_and_replace(input) == "nine NINE y nine xnine six six six u tt");
+    }
+
+    SECTION("Invalid replacement") {
+        replacer_type replacer;
+        REQUIRE_THROWS_AS(replacer.add_replacements({ { "one", "1", robolina::case_mode::preserve_case, false }, { "", "x", robolina::case_mode::match_case, false }, { "two", "2", robolina::case_mode::match_case, false } }), std::invalid_argument);
+        REQUIRE(replacer.find_and_replace(std::string("one two")) == "1 two");
+    }
+}
+
 TEST_CASE("Overlapping patterns", "[robolina]")
 {
     robolina::case_preserve_replacer<char> replacer;
@@ -302,3 +416,477 @@ TEST_CASE("Surrounding whitespace", "[robolina]")
         REQUIRE(result == expected);
     }
 }
+
+TEST_CASE("Compiled replacer", "[robolina]")
+{
+    robolina::case_preserve_replacer<char> replacer;
+    replacer.add_replacement("one two", "four five", robolina::case_mode::ignore_case);
+    replacer.add_replacement("two three", "five six", robolina::case_mode::preserve_case);
+    replacer.add_replacement("one", "seven", robolina::case_mode::match_case, true);
+    REQUIRE(replacer.compiled_size_in_bytes() == 0);
+    replacer.compile();
+    REQUIRE(replacer.compiled_size_in_bytes() > 0);
+
+    SECTION("Same results as without compiling") {
+        std::string input = "one two three, TwoThree, one, oneone, ONE TWO";
+        std::string expected = "four five three, FiveSix, seven, oneone, four five";
+        std::string result = replacer.find_and_replace(input);
+        REQUIRE(result == expected);
+    }
+}
+
+TEST_CASE("Compiled wide string replacer", "[robolina]")
+{
+    robolina::case_preserve_replacer<wchar_t> replacer;
+    replacer.add_replacement(L"\u0444\u043e\u043e bar", L"baz \u0445", robolina::case_mode::preserve_case);
+    replacer.add_replacement(L"\u4e00\u4e8c", L"\u4e09", robolina::case_mode::ignore_case);
+    replacer.compile();
+
+    SECTION("Characters above 255") {
+        std::wstring input = L"x \u0444\u043e\u043e_bar \u4e00\u4e00\u4e8c";
+        std::wstring expected = L"x baz_\u0445 \u4e00\u4e09";
+        std::wstring result = replacer.find_and_replace(input);
+        REQUIRE(result == expected);
+    }
+}
+
+TEST_CASE("Saved compiled replacer", "[robolina]")
+{
+    robolina::case_preserve_replacer<char> replacer;
+    replacer.add_replacement("one two", "four five", robolina::case_mode::ignore_case);
+    replacer.add_replacement("two three", "five six", robolina::case_mode::preserve_case);
+    replacer.add_replacement("one", "seven", robolina::case_mode::match_case, true);
+    std::vector<char> data;
+    REQUIRE_THROWS_AS(replacer.save_compiled(data), std::logic_error);
+    replacer.compile();
+    replacer.save_compiled(data);
+    // Aligned to 8 bytes like a memory-mapped file.
+    std::vector<std::uint64_t> aligned_data((data.size() + 7) / 8);
+    std::memcpy(aligned_data.data(), data.data(), data.size());
+    const char* p_data = reinterpret_cast<const char*>(aligned_data.data());
+    const std::string input = "one two three, TwoThree, one, oneone, ONE TWO";
+    const std::string expected = "four five three, FiveSix, seven, oneone, four five";
+
+    SECTION("Same results as the saved replacer") {
+        robolina::case_preserve_replacer<char> loaded_replacer;
+        loaded_replacer.add_replacement("one", "eight", robolina::case_mode::ignore_case);
+        loaded_replacer.load_compiled(p_data, data.size());
+        REQUIRE(loaded_replacer.find_and_replace(input) == expected);
+        REQUIRE(loaded_replacer.get_memory_usage().replacements == 0);
+        std::vector<char> saved_again;
+        loaded_replacer.save_compiled(saved_again);
+        REQUIRE(saved_again == data);
+    }
+
+    SECTION("Loaded replacer cannot get more replacement rules") {
+        robolina::case_preserve_replacer<char> loaded_replacer;
+        loaded_replacer.load_compiled(p_data, data.size());
+        REQUIRE_THROWS_AS(loaded_replacer.add_replacement("three", "3", robolina::case_mode::match_case), std::logic_error);
+        loaded_replacer.compile();
+        REQUIRE(loaded_replacer.find_and_replace(input) == expected);
+    }
+
+    SECTION("Wide string replacer") {
+        robolina::case_preserve_replacer<wchar_t> wide_replacer;
+        wide_replacer.add_replacement(L"\u0444\u043e\u043e bar", L"baz \u0445", robolina::case_mode::preserve_case);
+        wide_replacer.add_replacement(L"\u4e00\u4e8c", L"\u4e09", robolina::case_mode::ignore_case);
+        wide_replacer.compile();
+        std::vector<char> wide_data;
+        wide_replacer.save_compiled(wide_data);
+        std::vector<std::uint64_t> aligned_wide_data((wide_data.size() + 7) / 8);
+        std::memcpy(aligned_wide_data.data(), wide_data.data(), wide_data.size());
+        robolina::case_preserve_replacer<wchar_t> loaded_replacer;
+        loaded_replacer.load_compiled(reinterpret_cast<const char*>(aligned_wide_data.data()), wide_data.size());
+        REQUIRE(loaded_replacer.find_and_replace(std::wstring(L"x \u0444\u043e\u043e_bar \u4e00\u4e00\u4e8c")) == L"x baz_\u0445 \u4e00\u4e09");
+        REQUIRE_THROWS_AS(replacer.load_compiled(reinterpret_cast<const char*>(aligned_wide_data.data()), wide_data.size()), std::invalid_argument);
+    }
+
+    SECTION("Invalid data") {
+        robolina::case_preserve_replacer<char> loaded_replacer;
+        REQUIRE_THROWS_AS(loaded_replacer.load_compiled(p_data, data.size() - 8), std::invalid_argument);
+        REQUIRE_THROWS_AS(loaded_replacer.load_compiled(p_data, 0), std::invalid_argument);
+        REQUIRE_THROWS_AS(loaded_replacer.load_compiled(p_data + 1, data.size() - 1), std::invalid_argument);
+        robolina::case_preserve_replacer<char, std::uint16_t> other_replacer;
+        REQUIRE_THROWS_AS(other_replacer.load_compiled(p_data, data.size()), std::invalid_argument);
+
+        // The format version follows the 8 characters at the begin.
+        aligned_data[1] = robolina::case_preserve_replacer<char>::c_compiled_format_version + 1;
+        REQUIRE_THROWS_AS(loaded_replacer.load_compiled(p_data, data.size()), std::invalid_argument);
+        aligned_data[1] = robolina::case_preserve_replacer<char>::c_compiled_format_version;
+        loaded_replacer.load_compiled(p_data, data.size());
+
+        // The length of the text to find of the first entry, after the header of 8 values.
+        aligned_data[1 + 7 + 1] = 1000;
+        REQUIRE_THROWS_AS(loaded_replacer.load_compiled(p_data, data.size()), std::invalid_argument);
+        REQUIRE(loaded_replacer.find_and_replace(input) == input);
+    }
+}
+
+TEST_CASE("Ignore case and match case tokens at the same position", "[robolina]")
+{
+    robolina::case_preserve_replacer<char> replacer;
+    replacer.add_replacement("ab", "<i>", robolina::case_mode::ignore_case);
+    replacer.add_replacement("abc", "<m>", robolina::case_mode::match_case);
+    replacer.add_replacement("CD", "<w>", robolina::case_mode::ignore_case, true);
+    replacer.add_replacement("cde", "<c>", robolina::case_mode::match_case);
+
+    SECTION("Ignore case token wins at the same position, the first token wins otherwise") {
+        std::string input = "abc Abc xabc bcde";
+        std::string expected = "<i>c <i>c x<i>c b<c>";
+        REQUIRE(replacer.find_and_replace(input) == expected);
+        replacer.compile();
+        REQUIRE(replacer.find_and_replace(input) == expected);
+    }
+
+    SECTION("Rejected whole word token does not hide the other case mode") {
+        std::string input = "cde cd";
+        std::string expected = "<c> <w>";
+        REQUIRE(replacer.find_and_replace(input) == expected);
+        replacer.compile();
+        REQUIRE(replacer.find_and_replace(input) == expected);
+    }
+}
+
+TEST_CASE("Text to find which is not a whole word", "[robolina]")
+{
+    robolina::case_preserve_replacer<char> replacer;
+    replacer.add_replacement("one two", "<1>", robolina::case_mode::ignore_case, true);
+    replacer.add_replacement("one", "<2>", robolina::case_mode::match_case);
+    replacer.add_replacement("two three", "<3>", robolina::case_mode::ignore_case, true);
+
+    SECTION("Shorter text to find of the other case mode still matches") {
+        std::string input = "one twox, one two";
+        std::string expected = "<2> twox, <1>";
+        REQUIRE(replacer.find_and_replace(input) == expected);
+        replacer.compile();
+        REQUIRE(replacer.find_and_replace(input) == expected);
+    }
+
+    SECTION("Overlapping text to find of the same case mode is skipped") {
+        std::string input = "xone two three";
+        std::string expected = "x<2> two three";
+        REQUIRE(replacer.find_and_replace(input) == expected);
+        replacer.compile();
+        REQUIRE(replacer.find_and_replace(input) == expected);
+    }
+
+    SECTION("Shorter text to find of the same case mode is skipped") {
+        robolina::case_preserve_replacer<char> match_case_replacer;
+        match_case_replacer.add_replacement("foo bar", "X", robolina::case_mode::match_case, true);
+        match_case_replacer.add_replacement("bar", "Y", robolina::case_mode::match_case);
+        std::string input = "foo barz foo bar";
+        std::string expected = "foo barz X";
+        REQUIRE(match_case_replacer.find_and_replace(input) == expected);
+        match_case_replacer.compile();
+        REQUIRE(match_case_replacer.find_and_replace(input) == expected);
+    }
+}
+
+TEST_CASE("Character classes of the ASCII characters", "[robolina]")
+{
+    SECTION("Only ASCII letters and digits are part of a word") {
+        auto replacer = create_replacer<char>("one", "two", robolina::case_mode::preserve_case, true);
+        REQUIRE(replacer.find_and_replace(std::string("\xC3\xA4one\xC3\xA4 one9 _One_ ONE")) == "\xC3\xA4two\xC3\xA4 one9 _Two_ TWO");
+    }
+
+    SECTION("Only ASCII letters are folded") {
+        auto replacer = create_replacer<wchar_t>(L"\u00C4b", L"x", robolina::case_mode::ignore_case);
+        REQUIRE(replacer.find_and_replace(std::wstring(L"\u00C4B \u00E4b")) == L"x \u00E4b");
+    }
+}
+
+TEST_CASE("Text with null characters", "[robolina]")
+{
+    robolina::case_preserve_replacer<char> replacer;
+    replacer.add_replacement("one two", "three four", robolina::case_mode::preserve_case, true);
+    const std::string input("one_two\0oneTwo\0ONE-TWO", 22);
+    const std::string expected("three_four\0threeFour\0THREE-FOUR", 31);
+
+    SECTION("Null characters do not stop the search") {
+        REQUIRE(replacer.find_and_replace(input) == expected);
+        replacer.compile();
+        REQUIRE(replacer.find_and_replace(input) == expected);
+    }
+
+    SECTION("Character range without null terminator") {
+        // The text to find continues after the end of the range, so it must not be found.
+        std::string result;
+        struct string_sink
+        {
+            std::string& result;
+            void write(const char* begin, const char* end) { result.append(begin, end); }
+        } sink{ result };
+        replacer.find_and_replace(input.data() + 8, input.data() + 13, sink);
+        REQUIRE(result == "oneTw");
+        result.clear();
+        replacer.find_and_replace(input.data() + 8, input.data() + 14, sink);
+        REQUIRE(result == "threeFour");
+    }
+
+#if defined(ROBOLINA_HAS_STRING_VIEW)
+    SECTION("String view") {
+        REQUIRE(replacer.find_and_replace(std::string_view(input)) == expected);
+        REQUIRE(replacer.find_and_replace(std::string_view(input).substr(0, 7)) == "three_four");
+        REQUIRE(replacer.find_and_replace("xone_two") == "xone_two");
+    }
+#endif
+}
+
+TEST_CASE("Find the first match", "[robolina]")
+{
+    robolina::case_preserve_replacer<char> replacer;
+    replacer.add_replacement("one two", "three four", robolina::case_mode::preserve_case, true);
+    replacer.add_replacement("five", "six", robolina::case_mode::match_case);
+
+    for (int compiled = 0; compiled < 2; ++compiled)
+    {
+        if (compiled)
+        {
+            replacer.compile();
+        }
+        const std::string text = "xoneTwo fiv ONE_TWO five";
+        const char* match_begin = nullptr;
+        const char* match_end = nullptr;
+        REQUIRE(replacer.first_match(text.data(), text.data() + text.size(), match_begin, match_end));
+        REQUIRE(match_begin == text.data() + 12);
+        REQUIRE(match_end == text.data() + 19);
+
+        REQUIRE(replacer.contains_match(text));
+        REQUIRE(replacer.contains_match(text.data() + 19, text.data() + text.size()));
+        REQUIRE_FALSE(replacer.contains_match(text.data(), text.data() + 11));
+        REQUIRE_FALSE(replacer.contains_match(std::string()));
+    }
+}
+
+TEST_CASE("Edit list", "[robolina]")
+{
+    typedef robolina::case_preserve_replacer<char> replacer_type;
+    replacer_type replacer;
+    replacer.add_replacement("one two", "three four", robolina::case_mode::preserve_case, true);
+    replacer.add_replacement("five", "6", robolina::case_mode::ignore_case);
+    const std::string text = "oneTwo, FIVE xone_two ONE_TWO";
+    std::vector<replacer_type::edit> edits;
+
+    SECTION("Edits of the found texts") {
+        replacer.find_edits(text.data(), text.data() + text.size(), edits);
+        REQUIRE(edits.size() == 3);
+        REQUIRE(edits[0].offset == 0);
+        REQUIRE(edits[0].length == 6);
+        REQUIRE(replacer.get_replacement_text(edits[0].replacement_id) == "threeFour");
+        REQUIRE(edits[1].offset == 8);
+        REQUIRE(edits[1].length == 4);
+        REQUIRE(replacer.get_replacement_text(edits[1].replacement_id) == "6");
+        REQUIRE(edits[2].offset == 22);
+        REQUIRE(replacer.get_replacement_text(edits[2].replacement_id) == "THREE_FOUR");
+        REQUIRE(replacer.get_replacement_text(edits[2].replacement_id).size() == 10);
+        REQUIRE_FALSE(replacer.get_replacement_text(edits[2].replacement_id) == "THREE_FOUR_");
+        REQUIRE_THROWS_AS(replacer.get_replacement_text(1000), std::out_of_range);
+
+        // A replacement text in the casing of the found text is held by the range and its copies.
+        replacer_type::text_range copied_text = replacer.get_replacement_text(edits[1].replacement_id);
+        REQUIRE(copied_text == "6");
+        copied_text = replacer.get_replacement_text(edits[0].replacement_id);
+        const replacer_type::text_range copy = copied_text;
+        REQUIRE(copy == "threeFour");
+        REQUIRE(copy.to_string() == "threeFour");
+        REQUIRE(copy.data() != copied_text.data());
+    }
+
+    SECTION("Applied edits give the same result as find_and_replace") {
+        replacer.compile();
+        replacer.find_edits(text.data(), text.data() + text.size(), edits);
+        std::string result;
+        struct string_sink
+        {
+            std::string& result;
+            void write(const char* begin, const char* end) { result.append(begin, end); }
+        } sink{ result };
+        replacer.apply_edits(text.data(), text.data() + text.size(), edits, sink);
+        REQUIRE(result == replacer.find_and_replace(text));
+
+        // The previous edits are removed.
+        replacer.find_edits(text.data(), text.data() + 6, edits);
+        REQUIRE(edits.size() == 1);
+        replacer.find_edits(text.data() + 1, text.data() + 6, edits);
+        REQUIRE(edits.empty());
+    }
+
+    SECTION("Invalid edits") {
+        replacer.find_edits(text.data(), text.data() + text.size(), edits);
+        std::swap(edits[0], edits[1]);
+        struct null_sink
+        {
+            void write(const char*, const char*) {}
+        } sink;
+        REQUIRE_THROWS_AS(replacer.apply_edits(text.data(), text.data() + text.size(), edits, sink), std::invalid_argument);
+        REQUIRE_THROWS_AS(replacer.apply_edits(text.data(), text.data() + 10, edits, sink), std::invalid_argument);
+    }
+}
+
+TEST_CASE("Parallel search", "[robolina]")
+{
+    typedef robolina::case_preserve_replacer<char> replacer_type;
+    replacer_type replacer;
+    replacer.add_replacement("aaa", "1", robolina::case_mode::match_case);
+    replacer.add_replacement("ab", "2", robolina::case_mode::ignore_case);
+    replacer.add_replacement("baab", "3", robolina::case_mode::match_case, true);
+    replacer.add_replacement("a b", "c d", robolina::case_mode::preserve_case);
+    replacer.add_replacement("bbbbbbba", "4", robolina::case_mode::match_case);
+    replacer.add_replacement("bab", "5", robolina::case_mode::ignore_case, true);
+
+    // Many overlapping matches, so the matches found across the chunk boundaries differ from those of the chunks.
+    std::mt19937 generator(7);
+    const char characters[] = { 'a', 'a', 'b', 'A', 'B', ' ', '_' };
+    std::string text;
+    for (size_t i = 0; i < 5000; ++i)
+    {
+        text += characters[generator() % sizeof(characters)];
+    }
+    std::vector<replacer_type::edit> expected_edits;
+    std::vector<replacer_type::edit> edits;
+
+    SECTION("Same edits as the sequential search") {
+        for (int compiled = 0; compiled < 2; ++compiled)
+        {
+            if (compiled)
+            {
+                replacer.compile();
+            }
+            for (size_t size : { size_t(0), size_t(1), size_t(7), size_t(100), text.size() })
+            {
+                replacer.find_edits(text.data(), text.data() + size, expected_edits);
+                for (size_t thread_count = 1; thread_count <= 16; ++thread_count)
+                {
+                    replacer.find_edits_parallel(text.data(), text.data() + size, edits, thread_count, 1);
+                    REQUIRE(edits.size() == expected_edits.size());
+                    for (size_t i = 0; i < edits.size(); ++i)
+                    {
+                        REQUIRE(edits[i].offset == expected_edits[i].offset);
+                        REQUIRE(edits[i].length == expected_edits[i].length);
+                        REQUIRE(edits[i].replacement_id == expected_edits[i].replacement_id);
+                    }
+                }
+            }
+        }
+    }
+
+    SECTION("Same result as find_and_replace") {
+        std::string result;
+        struct string_sink
+        {
+            std::string& result;
+            void write(const char* begin, const char* end) { result.append(begin, end); }
+        } sink{ result };
+        replacer.find_and_replace_parallel(text.data(), text.data() + text.size(), sink, 4, 100);
+        REQUIRE(result == replacer.find_and_replace(text));
+
+        // A text smaller than the minimum chunk size is searched by the calling thread.
+        result.clear();
+        replacer.find_and_replace_parallel(text.data(), text.data() + text.size(), sink);
+        REQUIRE(result == replacer.find_and_replace(text));
+    }
+}
+
+TEST_CASE("Stream replacer", "[robolina]")
+{
+    typedef robolina::case_preserve_replacer<char> replacer_type;
+    replacer_type replacer;
+    replacer.add_replacement("one two", "three four", robolina::case_mode::preserve_case, true);
+    replacer.add_replacement("ab", "2", robolina::case_mode::ignore_case);
+    replacer.add_replacement("aaa", "1", robolina::case_mode::match_case);
+    replacer.add_replacement("b1", "x", robolina::case_mode::match_case, true);
+
+    std::mt19937 generator(11);
+    const char* words[] = { "a", "b", "ab", "aaa", "1", "b1", "one", "two", "One", "TWO", " ", "_", "-", "\n" };
+    std::string text;
+    for (size_t i = 0; i < 2000; ++i)
+    {
+        text += words[generator() % (sizeof(words) / sizeof(words[0]))];
+    }
+
+    struct string_sink
+    {
+        std::string& result;
+        void write(const char* begin, const char* end) { result.append(begin, end); }
+    };
+
+    SECTION("Same result as find_and_replace for any chunk size") {
+        for (int compiled = 0; compiled < 2; ++compiled)
+        {
+            if (compiled)
+            {
+                replacer.compile();
+            }
+            const std::string expected = replacer.find_and_replace(text);
+            for (size_t block_size : { size_t(1), size_t(5), size_t(64 * 1024) })
+            {
+                std::string result;
+                string_sink sink{ result };
+                replacer_type::stream_replacer<string_sink> stream(replacer, sink, block_size);
+                for (size_t chunk_size = 1; chunk_size <= 9; ++chunk_size)
+                {
+                    result.clear();
+                    for (size_t offset = 0; offset < text.size(); offset += chunk_size)
+                    {
+                        stream.write(text.data() + offset, text.data() + std::min(text.size(), offset + chunk_size));
+                    }
+                    stream.finish();
+                    REQUIRE(result == expected);
+                }
+            }
+        }
+    }
+
+    SECTION("Text ending with a text to find") {
+        std::string result;
+        string_sink sink{ result };
+        replacer_type::stream_replacer<string_sink> stream(replacer, sink, 1);
+        const std::string input = "one two";
+        stream.write(input.data(), input.data() + input.size());
+        REQUIRE(result.empty());
+        stream.finish();
+        REQUIRE(result == "three four");
+
+        // The stream can be reused for another text, an empty text writes nothing.
+        result.clear();
+        stream.finish();
+        REQUIRE(result.empty());
+    }
+}
+
+TEST_CASE("Token ID type and memory usage", "[robolina]")
+{
+    SECTION("Smaller token ID type") {
+        robolina::case_preserve_replacer<char, std::uint16_t> replacer;
+        replacer.add_replacement("one two", "three four", robolina::case_mode::preserve_case, true);
+        replacer.add_replacement("five", "6", robolina::case_mode::ignore_case);
+        const std::string input = "oneTwo, FIVE xone_two ONE_TWO";
+        REQUIRE(replacer.find_and_replace(input) == "threeFour, 6 xone_two THREE_FOUR");
+    }
+
+    SECTION("Too many texts to find") {
+        robolina::case_preserve_replacer<char, std::uint8_t> replacer;
+        for (int i = 0; i < 255; ++i)
+        {
+            replacer.add_replacement(std::to_string(i).c_str(), "x", robolina::case_mode::match_case);
+        }
+        REQUIRE_THROWS_AS(replacer.add_replacement("255", "x", robolina::case_mode::match_case), std::length_error);
+        REQUIRE(replacer.find_and_replace(std::string("254, 255")) == "x, xx");
+    }
+
+    SECTION("Memory usage") {
+        robolina::case_preserve_replacer<char> replacer;
+        REQUIRE(replacer.get_memory_usage().total() == 0);
+        replacer.add_replacement("one two", "a much longer replacement text on the heap", robolina::case_mode::preserve_case);
+        auto usage = replacer.get_memory_usage();
+        REQUIRE(usage.search_tree > 0);
+        REQUIRE(usage.compiled == 0);
+        // The words are stored once, not in each case form.
+        REQUIRE(usage.replacements >= 7 + 42);
+        REQUIRE(usage.replacements < 9 * 42);
+        replacer.compile();
+        usage = replacer.get_memory_usage();
+        REQUIRE(usage.compiled == replacer.compiled_size_in_bytes());
+        REQUIRE(usage.total() == usage.search_tree + usage.compiled + usage.replacements);
+    }
+}